@@ -278,6 +278,24 @@ void ArcEager::split(const unsigned & action,
   }
 }
 
+bool ArcEager::get_arc(const TransitionState& state,
+                       const unsigned& action,
+                       unsigned& hed,
+                       unsigned& mod,
+                       unsigned& deprel) const {
+  if (is_left(action)) {
+    mod = state.stack.back();
+    hed = state.buffer.back();
+  } else if (is_right(action)) {
+    hed = state.stack.back();
+    mod = state.buffer.back();
+  } else {
+    return false;
+  }
+  deprel = parse_label(action);
+  return true;
+}
+
 void ArcEager::get_oracle_actions_onestep(const std::vector<unsigned>& ref_heads,
                                           const std::vector<unsigned>& ref_deprels,
                                           std::vector<unsigned>& sigma,
@@ -252,6 +252,24 @@ void ArcHybrid::split(const unsigned & action,
   } 
 }
 
+bool ArcHybrid::get_arc(const TransitionState& state,
+                        const unsigned& action,
+                        unsigned& hed,
+                        unsigned& mod,
+                        unsigned& deprel) const {
+  if (is_left(action)) {
+    mod = state.stack.back();
+    hed = state.buffer.back();
+  } else if (is_right(action)) {
+    mod = state.stack.back();
+    hed = state.stack[state.stack.size() - 2];
+  } else {
+    return false;
+  }
+  deprel = parse_label(action);
+  return true;
+}
+
 void ArcHybrid::get_oracle_actions_onestep(const std::vector<unsigned>& heads,
                                            const std::vector<unsigned>& deprels,
                                            std::vector<unsigned>& sigma,
@@ -40,6 +40,12 @@ struct ArcHybrid : public TransitionSystem {
 
   void split(const unsigned & action, unsigned & structure, unsigned & deprel) override;
 
+  bool get_arc(const TransitionState& state,
+               const unsigned& action,
+               unsigned& hed,
+               unsigned& mod,
+               unsigned& deprel) const override;
+
   void shift_unsafe(TransitionState& state) const;
   void left_unsafe(TransitionState& state, const unsigned& deprel) const;
   void right_unsafe(TransitionState& state, const unsigned& deprel) const;
@@ -281,6 +281,24 @@ void ArcStandard::split(const unsigned & action, unsigned & structure, unsigned
   } 
 }
 
+bool ArcStandard::get_arc(const TransitionState& state,
+                          const unsigned& action,
+                          unsigned& hed,
+                          unsigned& mod,
+                          unsigned& deprel) const {
+  if (is_left(action)) {
+    hed = state.stack.back();
+    mod = state.stack[state.stack.size() - 2];
+  } else if (is_right(action)) {
+    mod = state.stack.back();
+    hed = state.stack[state.stack.size() - 2];
+  } else {
+    return false;
+  }
+  deprel = parse_label(action);
+  return true;
+}
+
 void ArcStandard::get_oracle_actions_onestep(const std::vector<unsigned>& heads,
                                              const std::vector<unsigned>& deprels,
                                              std::vector<unsigned>& sigma,
@@ -0,0 +1,149 @@
+#include "async_evaluator.h"
+#include "logging.h"
+#include "shm_utils.h"
+#include <cstdio>
+#ifndef _MSC_VER
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+po::options_description AsyncEvaluator::get_options() {
+  po::options_description cmd("Evaluation options");
+  cmd.add_options()
+    ("evaluate_async", po::value<bool>()->default_value(false), "Evaluate and save a snapshot of the parameters in background while training continues.")
+    ;
+  return cmd;
+}
+
+AsyncEvaluator::AsyncEvaluator(const po::variables_map & conf,
+                               dynet::ParameterCollection & model,
+                               const std::string & name) :
+  model(model),
+  name(name),
+  snapshot(name + ".snapshot"),
+  async(false),
+  shared(false),
+  pid(-1),
+  fd(-1) {
+  if (conf.count("evaluate_async")) { async = conf["evaluate_async"].as<bool>(); }
+#ifdef _MSC_VER
+  if (async) {
+    _WARN << "AsyncEval:: background evaluation is not supported, fallback to blocking evaluation.";
+    async = false;
+  }
+#endif
+  _INFO << "AsyncEval:: background evaluation = " << (async ? "enabled" : "disabled");
+}
+
+AsyncEvaluator::~AsyncEvaluator() {
+  wait();
+}
+
+void AsyncEvaluator::set_shared(bool shared_) {
+  shared = shared_;
+}
+
+void AsyncEvaluator::evaluate_blocking(const EvaluateFunc & func,
+                                       const Callback & callback) {
+  float f = func();
+  if (callback(f)) { dynet::save_dynet_model(name, (&model)); }
+}
+
+void AsyncEvaluator::evaluate(const EvaluateFunc & func,
+                              const Callback & callback) {
+  if (!async) {
+    evaluate_blocking(func, callback);
+    return;
+  }
+  // only one snapshot is alive at a time.
+  wait();
+#ifndef _MSC_VER
+  int fds[2];
+  if (pipe(fds) != 0) {
+    _WARN << "AsyncEval:: failed to create pipe, evaluate in foreground.";
+    evaluate_blocking(func, callback);
+    return;
+  }
+  pid_t child = fork();
+  if (child < 0) {
+    _WARN << "AsyncEval:: failed to fork, evaluate in foreground.";
+    close(fds[0]);
+    close(fds[1]);
+    evaluate_blocking(func, callback);
+    return;
+  }
+  if (child == 0) {
+    close(fds[0]);
+    if (shared) {
+      // release the parent once the snapshot is private.
+      char ack = (unshare_parameters(model) ? 1 : 0);
+      if (write(fds[1], &ack, 1) != 1 || !ack) { _exit(1); }
+    }
+    float f = func();
+    dynet::save_dynet_model(snapshot, (&model));
+    ssize_t n = write(fds[1], &f, sizeof(f));
+    close(fds[1]);
+    _exit(n == sizeof(f) ? 0 : 1);
+  }
+  close(fds[1]);
+  if (shared) {
+    char ack = 0;
+    if (read(fds[0], &ack, 1) != 1 || !ack) {
+      _WARN << "AsyncEval:: failed to snapshot the shared parameters, evaluate in foreground.";
+      close(fds[0]);
+      waitpid(child, nullptr, 0);
+      evaluate_blocking(func, callback);
+      return;
+    }
+  }
+  pid = child;
+  fd = fds[0];
+  pending = callback;
+  _TRACE << "AsyncEval:: evaluation started in process " << pid;
+#endif
+}
+
+void AsyncEvaluator::poll() {
+#ifndef _MSC_VER
+  if (pid < 0) { return; }
+  int status = 0;
+  if (waitpid(pid, &status, WNOHANG) == pid) { finish(status); }
+#endif
+}
+
+void AsyncEvaluator::wait() {
+#ifndef _MSC_VER
+  if (pid < 0) { return; }
+  int status = 0;
+  if (waitpid(pid, &status, 0) == pid) {
+    finish(status);
+  } else {
+    _ERROR << "AsyncEval:: lost evaluation process " << pid;
+    close(fd);
+    pid = -1;
+    fd = -1;
+  }
+#endif
+}
+
+void AsyncEvaluator::finish(int status) {
+#ifndef _MSC_VER
+  float f = 0.f;
+  bool ok = (WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+             read(fd, &f, sizeof(f)) == sizeof(f));
+  close(fd);
+  pid = -1;
+  fd = -1;
+  if (!ok) {
+    _ERROR << "AsyncEval:: background evaluation failed.";
+    std::remove(snapshot.c_str());
+    return;
+  }
+  if (pending(f)) {
+    std::rename(snapshot.c_str(), name.c_str());
+  } else {
+    std::remove(snapshot.c_str());
+  }
+#endif
+}
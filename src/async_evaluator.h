@@ -0,0 +1,58 @@
+#ifndef ASYNC_EVALUATOR_H
+#define ASYNC_EVALUATOR_H
+
+#include <iostream>
+#include <functional>
+#include <boost/program_options.hpp>
+#include "dynet/model.h"
+
+namespace po = boost::program_options;
+
+/// Run the development evaluation (and the checkpointing) in a background
+/// process. The child process is forked from the trainer so that it holds a
+/// copy-on-write snapshot of the parameters at the moment of evaluation, while
+/// the parent keeps on updating its own copy. At most one evaluation is in
+/// flight. The callback is invoked in the parent once the score is available
+/// and decides whether the evaluated snapshot becomes the saved model.
+/// When the parameters live in shared memory (the forked workers), the fork
+/// alone is no snapshot: the child first copies them into private memory and
+/// the parent is held until the copy is done.
+struct AsyncEvaluator {
+  typedef std::function<float()> EvaluateFunc;
+  /// return true to keep the evaluated parameters as the best model.
+  typedef std::function<bool(float)> Callback;
+
+  dynet::ParameterCollection & model;
+  std::string name;
+  std::string snapshot;
+  bool async;
+  /// the parameters are in shared memory, see share_parameters.
+  bool shared;
+  int pid;
+  int fd;
+  Callback pending;
+
+  static po::options_description get_options();
+
+  AsyncEvaluator(const po::variables_map & conf,
+                 dynet::ParameterCollection & model,
+                 const std::string & name);
+
+  ~AsyncEvaluator();
+
+  void set_shared(bool shared);
+
+  void evaluate(const EvaluateFunc & func, const Callback & callback);
+
+  /// Collect the in-flight evaluation if it has finished, never blocks.
+  void poll();
+
+  /// Block until the in-flight evaluation finishes.
+  void wait();
+
+  void evaluate_blocking(const EvaluateFunc & func, const Callback & callback);
+
+  void finish(int status);
+};
+
+#endif  //  end for ASYNC_EVALUATOR_H
@@ -0,0 +1,246 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include "dynet/init.h"
+#include "corpus.h"
+#include "logging.h"
+#include "synthetic.h"
+#include "parser_builder.h"
+#include "evaluate.h"
+#include "arcstd.h"
+#include "arceager.h"
+#include "archybrid.h"
+#include "swap.h"
+#include <boost/program_options.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string.hpp>
+
+namespace po = boost::program_options;
+
+void init_command_line(int argc, char* argv[], po::variables_map& conf) {
+  po::options_description general("Benchmark the decoding throughput of randomly initialized parsers on synthetic data.");
+  general.add_options()
+    ("architectures", po::value<std::string>()->default_value("d15,b15,k16"), "The architectures to benchmark.")
+    ("systems", po::value<std::string>()->default_value("arcstd,arceager,archybrid,swap"), "The transition systems to benchmark.")
+    ("beams", po::value<std::string>()->default_value("1,2,4,8,16,32,64"), "The beam sizes, the greedy decoder is always measured.")
+    ("sentences", po::value<unsigned>()->default_value(200), "The number of synthetic sentences.")
+    ("min_length", po::value<unsigned>()->default_value(5), "The minimum sentence length.")
+    ("max_length", po::value<unsigned>()->default_value(60), "The maximum sentence length.")
+    ("vocab", po::value<unsigned>()->default_value(20000), "The size of the synthetic vocabulary.")
+    ("zipf", po::value<double>()->default_value(1.), "The exponent of the Zipf distribution of words.")
+    ("postags", po::value<unsigned>()->default_value(40), "The number of POS tags.")
+    ("deprels", po::value<unsigned>()->default_value(40), "The number of dependency relations.")
+    ("seed", po::value<unsigned>()->default_value(1), "The random seed of the synthetic data.")
+    ("layers", po::value<unsigned>()->default_value(2), "The number of layers in LSTM.")
+    ("char_dim", po::value<unsigned>()->default_value(50), "The dimension of char.")
+    ("word_dim", po::value<unsigned>()->default_value(32), "The dimension of word.")
+    ("pos_dim", po::value<unsigned>()->default_value(12), "POS dim, set it as 0 to disable POS.")
+    ("pretrained_dim", po::value<unsigned>()->default_value(100), "Pretrained input dimension.")
+    ("action_dim", po::value<unsigned>()->default_value(20), "The dimension for action.")
+    ("label_dim", po::value<unsigned>()->default_value(20), "The dimension for label.")
+    ("lstm_input_dim", po::value<unsigned>()->default_value(100), "The dimension for lstm input.")
+    ("hidden_dim", po::value<unsigned>()->default_value(100), "The dimension for hidden unit.")
+    ("char_cache_size", po::value<unsigned>()->default_value(50000), "The number of word types whose char-LSTM vector is cached at inference (ballesteros15), 0 to disable.")
+    ("char_cache_precompute", "Precompute the char-LSTM vectors of the training vocabulary when entering inference (ballesteros15).")
+    ("input_cache_size", po::value<unsigned>()->default_value(100000), "The number of (word, pos, pretrained) inputs whose merged vector is cached at inference (dyer15, kiperwasser16), 0 to disable.")
+    ("native_inference", "Decode with the graph-free engine in the greedy evaluation (dyer15).")
+    ("check_reuse", "Instead of timing, check that decoding on the reused graph gives the same parses as a new graph per sentence.")
+    ("verbose,v", "Details logging.")
+    ("help,h", "show help information")
+    ;
+
+  po::store(po::parse_command_line(argc, argv, general), conf);
+  if (conf.count("help")) {
+    std::cerr << general << std::endl;
+    exit(1);
+  }
+  init_boost_log(conf.count("verbose") > 0);
+}
+
+/* Fill the training part of the corpus as load_training_data does. */
+void load_synthetic_data(const po::variables_map & conf, Corpus & corpus) {
+  SyntheticCorpus synthetic(conf["vocab"].as<unsigned>(),
+                            conf["zipf"].as<double>(),
+                            conf["postags"].as<unsigned>(),
+                            conf["deprels"].as<unsigned>(),
+                            conf["seed"].as<unsigned>());
+  unsigned min_length = std::max(conf["min_length"].as<unsigned>(), 1u);
+  unsigned max_length = std::max(conf["max_length"].as<unsigned>(), min_length);
+  if (max_length + 1 > TransitionState::MAX_N_WORDS) {
+    _ERROR << "Bench:: max_length should be less than " << TransitionState::MAX_N_WORDS;
+    exit(1);
+  }
+
+  corpus.word_map.insert(Corpus::BAD0);
+  corpus.word_map.insert(Corpus::UNK);
+  corpus.word_map.insert(Corpus::ROOT);
+  corpus.char_map.insert(Corpus::BAD0);
+  corpus.char_map.insert(Corpus::UNK);
+  corpus.char_map.insert(Corpus::ROOT);
+  corpus.pos_map.insert(Corpus::ROOT);
+  // every label is known to the transition systems, even if not sampled.
+  for (unsigned i = 0; i < synthetic.n_deprels; ++i) {
+    corpus.deprel_map.insert(SyntheticCorpus::deprel_name(i));
+  }
+
+  std::mt19937 gen(conf["seed"].as<unsigned>());
+  std::uniform_int_distribution<unsigned> length_distribution(min_length, max_length);
+  corpus.n_train = conf["sentences"].as<unsigned>();
+  for (unsigned sid = 0; sid < corpus.n_train; ++sid) {
+    std::string data = synthetic.sentence(length_distribution(gen), true, gen);
+    corpus.parse_data(data, corpus.training_inputs[sid], corpus.training_parses[sid], true, false);
+  }
+  corpus.get_vocabulary_and_word_count();
+}
+
+/* Decode all the sentences once, after a short warm-up. A beam size of 0
+ * stands for the greedy decoder. */
+void bench_decoder(const std::string & arch_name,
+                   const std::string & system_name,
+                   unsigned beam_size,
+                   Corpus & corpus,
+                   ParserStateBuilder & state_builder) {
+  typedef std::chrono::high_resolution_clock Clock;
+  dynet::ComputationGraph cg;
+  new_reused_graph(cg, state_builder);
+  auto decode = [&](unsigned sid) {
+    ParseUnits result;
+    if (beam_size == 0 && state_builder.native_greedy_decode(corpus.training_inputs[sid], result)) { return; }
+    cg.checkpoint();
+    if (beam_size == 0) {
+      greedy_decode(cg, state_builder, corpus.training_inputs[sid], result, true);
+    } else {
+      beam_decode(cg, state_builder, corpus.training_inputs[sid], beam_size, false, result, true);
+    }
+    cg.revert();
+  };
+
+  for (unsigned sid = 0; sid < corpus.n_train && sid < 5; ++sid) { decode(sid); }
+
+  unsigned long n_tokens = 0;
+  Clock::time_point start = Clock::now();
+  for (unsigned sid = 0; sid < corpus.n_train; ++sid) {
+    decode(sid);
+    // not counting the dummy root.
+    n_tokens += corpus.training_inputs[sid].size() - 1;
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  if (seconds <= 0.) { seconds = 1e-9; }
+
+  std::cout << arch_name << "\t" << system_name << "\t"
+    << (beam_size == 0 ? "greedy" : "beam") << "\t" << std::max(beam_size, 1u) << "\t"
+    << std::fixed << std::setprecision(2) << corpus.n_train / seconds << "\t"
+    << n_tokens / seconds << std::endl;
+}
+
+/* Decode all the sentences on one reused graph, then on a new graph per
+ * sentence, and count the sentences whose parses differ. The caches are
+ * cleared in between so that the second pass does not read the first. */
+unsigned check_reuse(unsigned beam_size,
+                     Corpus & corpus,
+                     ParserStateBuilder & state_builder) {
+  std::vector<ParseUnits> reused(corpus.n_train);
+  {
+    dynet::ComputationGraph cg;
+    new_reused_graph(cg, state_builder);
+    for (unsigned sid = 0; sid < corpus.n_train; ++sid) {
+      cg.checkpoint();
+      if (beam_size == 0) {
+        greedy_decode(cg, state_builder, corpus.training_inputs[sid], reused[sid], true);
+      } else {
+        beam_decode(cg, state_builder, corpus.training_inputs[sid], beam_size, false, reused[sid], true);
+      }
+      cg.revert();
+    }
+  }
+  state_builder.set_inference_mode(false);
+  state_builder.set_inference_mode(true);
+
+  unsigned n_diff = 0;
+  for (unsigned sid = 0; sid < corpus.n_train; ++sid) {
+    ParseUnits result;
+    dynet::ComputationGraph cg;
+    if (beam_size == 0) {
+      greedy_decode(cg, state_builder, corpus.training_inputs[sid], result);
+    } else {
+      beam_decode(cg, state_builder, corpus.training_inputs[sid], beam_size, false, result);
+    }
+    for (unsigned i = 0; i < result.size(); ++i) {
+      if (result[i].head != reused[sid][i].head || result[i].deprel != reused[sid][i].deprel) {
+        ++n_diff;
+        break;
+      }
+    }
+  }
+  return n_diff;
+}
+
+int main(int argc, char** argv) {
+  dynet::initialize(argc, argv, false);
+
+  po::variables_map conf;
+  init_command_line(argc, argv, conf);
+
+  std::vector<std::string> arch_names, system_names, beam_strs;
+  boost::algorithm::split(arch_names, conf["architectures"].as<std::string>(), boost::is_any_of(","));
+  boost::algorithm::split(system_names, conf["systems"].as<std::string>(), boost::is_any_of(","));
+  boost::algorithm::split(beam_strs, conf["beams"].as<std::string>(), boost::is_any_of(","));
+
+  Corpus corpus;
+  Embeddings pretrained;
+  corpus.load_empty_embeddings(conf["pretrained_dim"].as<unsigned>(), pretrained);
+  load_synthetic_data(conf, corpus);
+  corpus.stat();
+
+  unsigned n_failed = 0;
+  if (!conf.count("check_reuse")) {
+    std::cout << "#architecture\tsystem\tdecoder\tbeam\tsents/s\ttokens/s" << std::endl;
+  }
+  for (const std::string & system_name : system_names) {
+    TransitionSystem * system = nullptr;
+    if (system_name == "arcstd") {
+      system = new ArcStandard(corpus.deprel_map, "root");
+    } else if (system_name == "arceager") {
+      system = new ArcEager(corpus.deprel_map, "root");
+    } else if (system_name == "archybrid") {
+      system = new ArcHybrid(corpus.deprel_map, "root");
+    } else if (system_name == "swap") {
+      system = new Swap(corpus.deprel_map, "root");
+    } else {
+      _ERROR << "Bench:: Unknown transition system: " << system_name;
+      exit(1);
+    }
+
+    for (const std::string & arch_name : arch_names) {
+      // the weights are randomly initialized, decoding still runs through
+      // all the transitions of the sentence.
+      dynet::ParameterCollection model;
+      ParserStateBuilder * state_builder =
+        get_state_builder(arch_name, conf, model, (*system), corpus, pretrained);
+
+      state_builder->set_inference_mode(true);
+      if (conf.count("check_reuse")) {
+        std::vector<unsigned> beam_sizes = { 0 };
+        for (const std::string & beam_str : beam_strs) {
+          unsigned beam_size = boost::lexical_cast<unsigned>(beam_str);
+          if (beam_size > 1) { beam_sizes.push_back(beam_size); }
+        }
+        for (unsigned beam_size : beam_sizes) {
+          unsigned n_diff = check_reuse(beam_size, corpus, *state_builder);
+          std::cout << arch_name << "\t" << system_name << "\t"
+            << (beam_size == 0 ? "greedy" : "beam") << "\t" << std::max(beam_size, 1u) << "\t"
+            << n_diff << " of " << corpus.n_train << " sentences differ" << std::endl;
+          if (n_diff > 0) { n_failed++; }
+        }
+      } else {
+        bench_decoder(arch_name, system_name, 0, corpus, *state_builder);
+        for (const std::string & beam_str : beam_strs) {
+          unsigned beam_size = boost::lexical_cast<unsigned>(beam_str);
+          if (beam_size > 0) { bench_decoder(arch_name, system_name, beam_size, corpus, *state_builder); }
+        }
+      }
+      state_builder->set_inference_mode(false);
+    }
+  }
+  return (n_failed > 0 ? 1 : 0);
+}
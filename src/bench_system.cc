@@ -0,0 +1,259 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include "logging.h"
+#include "corpus.h"
+#include "tree.h"
+#include "synthetic.h"
+#include "arcstd.h"
+#include "arceager.h"
+#include "archybrid.h"
+#include "swap.h"
+#include <boost/program_options.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string.hpp>
+
+namespace po = boost::program_options;
+
+// all the heap allocations of the process are counted, the benchmark only
+// reads the counter around the measured loops.
+static unsigned long n_allocs = 0;
+// keep the results of the measured loops alive.
+static volatile unsigned long sink = 0;
+
+void * operator new(std::size_t size) {
+  ++n_allocs;
+  void * p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) { throw std::bad_alloc(); }
+  return p;
+}
+
+void * operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void * p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void * p) noexcept {
+  std::free(p);
+}
+
+struct Sample {
+  InputUnits input_units;
+  std::vector<unsigned> heads;
+  std::vector<unsigned> deprels;
+  std::vector<unsigned> actions;
+};
+
+struct Measure {
+  double ns;
+  unsigned long allocs;
+};
+
+typedef std::chrono::high_resolution_clock Clock;
+
+/* Run the function repeat times, keep the fastest run. */
+template <typename Function>
+Measure measure(unsigned repeat, Function f) {
+  Measure best;
+  best.ns = 1e300;
+  best.allocs = 0;
+  for (unsigned r = 0; r < repeat; ++r) {
+    unsigned long allocs = n_allocs;
+    Clock::time_point start = Clock::now();
+    f();
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    if (ns < best.ns) { best.ns = ns; best.allocs = n_allocs - allocs; }
+  }
+  return best;
+}
+
+void report(const std::string & system, const std::string & tree, unsigned len,
+            const std::string & operation, double ns, double allocs, unsigned long n_ops) {
+  std::cout << system << "\t" << tree << "\t" << len << "\t" << operation << "\t"
+    << std::fixed << std::setprecision(1) << (n_ops > 0 ? ns / n_ops : 0.) << "\t"
+    << std::setprecision(3) << (n_ops > 0 ? allocs / n_ops : 0.) << "\t"
+    << n_ops << std::endl;
+}
+
+/* The oracle is timed per sentence. The other operations are timed along the
+ * oracle path: perform_action by replaying it, get_valid_actions,
+ * get_transition_costs and the state copy as the extra cost over the replay.
+ * Output vectors are reused, so only the allocations inside the operation
+ * are counted. */
+void bench(TransitionSystem & system, const std::string & tree,
+           unsigned len, std::vector<Sample> & samples, unsigned repeat) {
+  std::string name = system.system_name();
+  unsigned long n_actions = 0;
+
+  Measure oracle = measure(repeat, [&]() {
+    for (Sample & sample : samples) {
+      // not every system clears the output actions.
+      sample.actions.clear();
+      system.get_oracle_actions(sample.heads, sample.deprels, sample.actions);
+    }
+  });
+  for (const Sample & sample : samples) { n_actions += sample.actions.size(); }
+
+  Measure replay = measure(repeat, [&]() {
+    for (const Sample & sample : samples) {
+      TransitionState state(sample.input_units.size());
+      state.initialize(sample.input_units);
+      for (unsigned a : sample.actions) { system.perform_action(state, a); }
+      sink = sink + state.stack.size();
+    }
+  });
+
+  std::vector<unsigned> valid_actions;
+  Measure valid = measure(repeat, [&]() {
+    for (const Sample & sample : samples) {
+      TransitionState state(sample.input_units.size());
+      state.initialize(sample.input_units);
+      for (unsigned a : sample.actions) {
+        system.get_valid_actions(state, valid_actions);
+        sink = sink + valid_actions.size();
+        system.perform_action(state, a);
+      }
+    }
+  });
+
+  Measure copy = measure(repeat, [&]() {
+    for (const Sample & sample : samples) {
+      TransitionState state(sample.input_units.size());
+      state.initialize(sample.input_units);
+      for (unsigned a : sample.actions) {
+        TransitionState new_state(state);
+        sink = sink + new_state.stack.size();
+        system.perform_action(state, a);
+      }
+    }
+  });
+
+  report(name, tree, len, "get_oracle_actions", oracle.ns, oracle.allocs, samples.size());
+  report(name, tree, len, "perform_action", replay.ns, replay.allocs, n_actions);
+  report(name, tree, len, "get_valid_actions", valid.ns - replay.ns,
+         double(valid.allocs) - double(replay.allocs), n_actions);
+
+  // the swap system does not define a dynamic oracle.
+  if (name != "swap") {
+    std::vector<float> costs;
+    Measure cost = measure(repeat, [&]() {
+      for (const Sample & sample : samples) {
+        TransitionState state(sample.input_units.size());
+        state.initialize(sample.input_units);
+        for (unsigned a : sample.actions) {
+          system.get_valid_actions(state, valid_actions);
+          system.get_transition_costs(state, valid_actions, sample.heads, sample.deprels, costs);
+          sink = sink + costs.size();
+          system.perform_action(state, a);
+        }
+      }
+    });
+    report(name, tree, len, "get_transition_costs", cost.ns - valid.ns,
+           double(cost.allocs) - double(valid.allocs), n_actions);
+  }
+  report(name, tree, len, "copy_state", copy.ns - replay.ns,
+         double(copy.allocs) - double(replay.allocs), n_actions);
+}
+
+/* Benchmark one system on the trees it can parse, of every length. */
+void bench_lengths(TransitionSystem & system,
+                   const std::vector<unsigned> & lengths,
+                   unsigned n_tokens,
+                   unsigned n_deprels,
+                   unsigned root_deprel,
+                   unsigned seed,
+                   unsigned repeat) {
+  // only the swap system handles non-projective trees.
+  std::vector<std::string> trees = { "projective" };
+  if (system.system_name() == "swap") { trees.push_back("non-projective"); }
+
+  for (const std::string & tree : trees) {
+    for (unsigned len : lengths) {
+      // the same trees for every system.
+      std::mt19937 gen(seed + len);
+      std::vector<Sample> samples(std::max(n_tokens / len, 1u));
+      for (Sample & sample : samples) {
+        sample.input_units.resize(len + 1);
+        if (tree == "projective") {
+          SyntheticTree::projective(len, n_deprels, root_deprel, gen, sample.heads, sample.deprels);
+        } else {
+          do {
+            SyntheticTree::random(len, n_deprels, root_deprel, gen, sample.heads, sample.deprels);
+          } while (len > 2 && DependencyUtils::is_projective(sample.heads));
+        }
+      }
+      bench(system, tree, len, samples, repeat);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  po::options_description cmd("Benchmark the transition systems on synthetic trees.");
+  cmd.add_options()
+    ("systems", po::value<std::string>()->default_value("arcstd,arceager,archybrid,swap"), "The transition systems to benchmark.")
+    ("lengths", po::value<std::string>()->default_value("10,30,100,300,1000"), "The sentence lengths.")
+    ("tokens", po::value<unsigned>()->default_value(50000), "The number of tokens generated for each length.")
+    ("deprels", po::value<unsigned>()->default_value(40), "The number of dependency relations.")
+    ("repeat", po::value<unsigned>()->default_value(3), "Repeat each measure n times and keep the fastest.")
+    ("seed", po::value<unsigned>()->default_value(1), "The random seed.")
+    ("verbose,v", "Details logging.")
+    ("help,h", "show help information")
+    ;
+  po::variables_map conf;
+  po::store(po::parse_command_line(argc, argv, cmd), conf);
+  if (conf.count("help")) {
+    std::cerr << cmd << std::endl;
+    exit(1);
+  }
+  init_boost_log(conf.count("verbose") > 0);
+
+  std::vector<std::string> system_names, length_strs;
+  boost::algorithm::split(system_names, conf["systems"].as<std::string>(), boost::is_any_of(","));
+  boost::algorithm::split(length_strs, conf["lengths"].as<std::string>(), boost::is_any_of(","));
+  unsigned n_tokens = conf["tokens"].as<unsigned>();
+  unsigned n_deprels = std::max(conf["deprels"].as<unsigned>(), 1u);
+  unsigned repeat = std::max(conf["repeat"].as<unsigned>(), 1u);
+  unsigned seed = conf["seed"].as<unsigned>();
+
+  std::vector<unsigned> lengths;
+  for (const std::string & length_str : length_strs) {
+    unsigned len = boost::lexical_cast<unsigned>(length_str);
+    if (len == 0 || len + 1 > TransitionState::MAX_N_WORDS) {
+      _WARN << "Bench:: skip length " << len << ", out of range.";
+      continue;
+    }
+    lengths.push_back(len);
+  }
+
+  Alphabet deprel_map;
+  unsigned root_deprel = deprel_map.insert("root");
+  for (unsigned i = 1; i < n_deprels; ++i) {
+    deprel_map.insert("dep" + boost::lexical_cast<std::string>(i));
+  }
+
+  std::cout << "#system\ttree\tlength\toperation\tns/op\tallocs/op\tops" << std::endl;
+  for (const std::string & system_name : system_names) {
+    if (system_name == "arcstd") {
+      ArcStandard system(deprel_map, "root");
+      bench_lengths(system, lengths, n_tokens, n_deprels, root_deprel, seed, repeat);
+    } else if (system_name == "arceager") {
+      ArcEager system(deprel_map, "root");
+      bench_lengths(system, lengths, n_tokens, n_deprels, root_deprel, seed, repeat);
+    } else if (system_name == "archybrid") {
+      ArcHybrid system(deprel_map, "root");
+      bench_lengths(system, lengths, n_tokens, n_deprels, root_deprel, seed, repeat);
+    } else if (system_name == "swap") {
+      Swap system(deprel_map, "root");
+      bench_lengths(system, lengths, n_tokens, n_deprels, root_deprel, seed, repeat);
+    } else {
+      _ERROR << "Bench:: Unknown transition system: " << system_name;
+      exit(1);
+    }
+  }
+  return 0;
+}
@@ -153,7 +153,9 @@ void Corpus::parse_data(const std::string& data,
     else if (boost::algorithm::to_lower_copy(tokens[1]) == "-rrb-") { tokens[1] = ")"; }
 
     BOOST_ASSERT_MSG(tokens.size() > 6, "Corpus:: Illegal conll format!");
-    
+
+    // the unit is reused across tokens, the chars of the previous token should not be kept.
+    input_unit.cids.clear();
     if (train) {
       input_unit.wid = word_map.insert(tokens[1]);
       input_unit.nid = (norm_map.contains(tokens[2]) ? norm_map.get(tokens[2]) : norm_map.get(Corpus::UNK));
@@ -212,6 +214,7 @@ void Corpus::parse_data(const std::string& data,
       parse_units.push_back(parse_unit);
     }
   }
+  input_unit.cids.clear();
   input_unit.wid = word_map.get(ROOT);
   input_unit.nid = norm_map.get(ROOT);
   input_unit.pid = pos_map.get(ROOT);
@@ -0,0 +1,93 @@
+#include "embedding_cache.h"
+
+EmbeddingCache::EmbeddingCache(unsigned capacity) :
+  capacity(capacity), n_hits(0), n_misses(0) {
+}
+
+const std::vector<float> * EmbeddingCache::get(const Key & key) {
+  auto it = index.find(key);
+  if (it == index.end()) {
+    ++n_misses;
+    return nullptr;
+  }
+  ++n_hits;
+  entries.splice(entries.begin(), entries, it->second);
+  return &(it->second->second);
+}
+
+void EmbeddingCache::put(const Key & key, const std::vector<float> & value) {
+  if (capacity == 0) { return; }
+  auto it = index.find(key);
+  if (it != index.end()) {
+    it->second->second = value;
+    entries.splice(entries.begin(), entries, it->second);
+    return;
+  }
+  if (entries.size() >= capacity) {
+    index.erase(entries.back().first);
+    entries.pop_back();
+  }
+  entries.push_front(std::make_pair(key, value));
+  index[key] = entries.begin();
+}
+
+void EmbeddingCache::put(dynet::ComputationGraph & cg,
+                         const std::vector<Key> & keys,
+                         const std::vector<dynet::Expression> & exprs) {
+  if (capacity == 0 || keys.empty()) { return; }
+  std::vector<float> values = dynet::as_vector(cg.incremental_forward(dynet::concatenate(exprs)));
+  unsigned dim = values.size() / keys.size();
+  for (unsigned k = 0; k < keys.size(); ++k) {
+    put(keys[k], std::vector<float>(values.begin() + k * dim, values.begin() + (k + 1) * dim));
+  }
+}
+
+void EmbeddingCache::clear() {
+  entries.clear();
+  index.clear();
+  n_hits = 0;
+  n_misses = 0;
+}
+
+double EmbeddingCache::hit_rate() const {
+  unsigned long n = n_hits + n_misses;
+  return (n > 0 ? double(n_hits) / n : 0.);
+}
+
+void get_cached_inputs(dynet::ComputationGraph & cg,
+                       EmbeddingCache & cache,
+                       bool use_cache,
+                       unsigned dim,
+                       const InputUnits & input,
+                       unsigned InputUnit::* pretrained_id,
+                       const Embeddings & pretrained,
+                       const std::function<dynet::Expression(unsigned, unsigned, unsigned)> & embed,
+                       std::vector<dynet::Expression> & inputs) {
+  use_cache = (use_cache && cache.capacity > 0);
+  std::vector<EmbeddingCache::Key> missed_keys;
+  std::vector<dynet::Expression> missed_exprs;
+  unsigned len = input.size();
+  inputs.resize(len);
+  for (unsigned i = 0; i < len; ++i) {
+    unsigned wid = input[i].wid;
+    unsigned pid = input[i].pid;
+    unsigned pre_id = input[i].*pretrained_id;
+    if (!pretrained.count(pre_id)) { pre_id = 0; }
+
+    EmbeddingCache::Key key;
+    if (use_cache) {
+      key = { wid, pid, pre_id };
+      const std::vector<float> * value = cache.get(key);
+      if (value != nullptr) {
+        inputs[i] = dynet::input(cg, { dim }, *value);
+        continue;
+      }
+    }
+    inputs[i] = embed(wid, pid, pre_id);
+    if (use_cache) {
+      missed_keys.push_back(key);
+      missed_exprs.push_back(inputs[i]);
+    }
+  }
+  cache.put(cg, missed_keys, missed_exprs);
+}
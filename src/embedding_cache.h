@@ -0,0 +1,56 @@
+#ifndef EMBEDDING_CACHE_H
+#define EMBEDDING_CACHE_H
+
+#include <list>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <boost/functional/hash.hpp>
+#include "dynet/expr.h"
+#include "corpus.h"
+
+/// A bounded LRU cache of finished word vectors keyed by a sequence of ids
+/// (e.g. the characters of the word). The vectors are only valid as long as
+/// the parameters are not updated, the owner should clear the cache then.
+struct EmbeddingCache {
+  typedef std::vector<unsigned> Key;
+  typedef std::list<std::pair<Key, std::vector<float>>> Entries;
+
+  unsigned capacity;
+  Entries entries;  // the most recently used first.
+  std::unordered_map<Key, Entries::iterator, boost::hash<Key>> index;
+  unsigned long n_hits;
+  unsigned long n_misses;
+
+  explicit EmbeddingCache(unsigned capacity);
+
+  /// Return the cached vector or nullptr, the pointer is valid until the next put.
+  const std::vector<float> * get(const Key & key);
+
+  void put(const Key & key, const std::vector<float> & value);
+
+  /// Put the values of the expressions, computed in one forward pass.
+  void put(dynet::ComputationGraph & cg,
+           const std::vector<Key> & keys,
+           const std::vector<dynet::Expression> & exprs);
+
+  void clear();
+
+  double hit_rate() const;
+};
+
+/// Get the input vector of each word by merging its (word, pos, pretrained)
+/// embeddings with embed. The pretrained id is read from the given field of
+/// the input unit, 0 if it is not in pretrained. With use_cache, the vectors
+/// are looked up by the three ids and the missed ones are put afterwards.
+void get_cached_inputs(dynet::ComputationGraph & cg,
+                       EmbeddingCache & cache,
+                       bool use_cache,
+                       unsigned dim,
+                       const InputUnits & input,
+                       unsigned InputUnit::* pretrained_id,
+                       const Embeddings & pretrained,
+                       const std::function<dynet::Expression(unsigned, unsigned, unsigned)> & embed,
+                       std::vector<dynet::Expression> & inputs);
+
+#endif  //  end for EMBEDDING_CACHE_H
@@ -11,6 +11,8 @@
 #include "train_supervised_ensemble_dynamic.h"
 #include "sys_utils.h"
 #include "trainer_utils.h"
+#include "async_evaluator.h"
+#include "trace.h"
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string.hpp>
 
@@ -38,13 +40,15 @@ void init_command_line(int argc, char* argv[], po::variables_map& conf) {
     ("label_dim", po::value<unsigned>()->default_value(20), "The dimension for label.")
     ("lstm_input_dim", po::value<unsigned>()->default_value(100), "The dimension for lstm input.")
     ("hidden_dim", po::value<unsigned>()->default_value(100), "The dimension for hidden unit.")
+    ("char_cache_size", po::value<unsigned>()->default_value(50000), "The number of word types whose char-LSTM vector is cached at inference (ballesteros15), 0 to disable.")
+    ("char_cache_precompute", "Precompute the char-LSTM vectors of the training vocabulary when entering inference (ballesteros15).")
+    ("input_cache_size", po::value<unsigned>()->default_value(100000), "The number of (word, pos, pretrained) inputs whose merged vector is cached at inference (dyer15, kiperwasser16), 0 to disable.")
     ("dropout", po::value<float>()->default_value(0.f), "The dropout rate.")
     ("max_iter", po::value<unsigned>()->default_value(10), "The maximum number of iteration.")
     ("report_stops", po::value<unsigned>()->default_value(100), "The reporting stops")
     ("evaluate_stops", po::value<unsigned>()->default_value(2500), "The evaluation stops")
     ("evaluate_skips", po::value<unsigned>()->default_value(0), "skip evaluation on the first n round.")
     ("external_eval", po::value<std::string>()->default_value("python ./script/eval.py"), "config the path for evaluation script")
-    ("lambda", po::value<float>()->default_value(0.), "The L2 regularizer, should not set in --dynet-l2.")
     ("output", po::value<std::string>(), "The path to the output file.")
     ("partial", po::value<bool>()->default_value(false), "The input data contains partial annotation.")
     ("test_ensemble", "Use to specify to test ensemble parser.")
@@ -55,6 +59,9 @@ void init_command_line(int argc, char* argv[], po::variables_map& conf) {
   po::options_description system_opt = TransitionSystemBuilder::get_options();
   po::options_description noisify_opt = Noisifier::get_options();
   po::options_description optimizer_opt = get_optimizer_options();
+  po::options_description regularizer_opt = L2Regularizer::get_options();
+  po::options_description evaluate_opt = AsyncEvaluator::get_options();
+  po::options_description trace_opt = Tracer::get_options();
   po::options_description supervise_opt = SupervisedEnsembleDynamicTrainer::get_options();
 
   po::options_description cmd("Allowed options");
@@ -62,6 +69,9 @@ void init_command_line(int argc, char* argv[], po::variables_map& conf) {
     .add(system_opt)
     .add(noisify_opt)
     .add(optimizer_opt)
+    .add(regularizer_opt)
+    .add(evaluate_opt)
+    .add(trace_opt)
     .add(supervise_opt)
     ;
 
@@ -81,6 +91,7 @@ int main(int argc, char** argv) {
 
   po::variables_map conf;
   init_command_line(argc, argv, conf);
+  Tracer::instance().initialize(conf);
 
   std::string model_name;
   if (conf.count("train")) {
@@ -107,7 +118,10 @@ int main(int argc, char** argv) {
                                  pretrained);
   }
 
-  corpus.load_training_data(conf["training_data"].as<std::string>(), allow_partial_tree);
+  {
+    TraceSpan span("load_training_data", true);
+    corpus.load_training_data(conf["training_data"].as<std::string>(), allow_partial_tree);
+  }
   corpus.stat();
   corpus.get_vocabulary_and_word_count();
   _INFO << "Main:: after loading pretrained embedding, size(vocabulary)=" << corpus.word_map.size();
@@ -132,7 +146,10 @@ int main(int argc, char** argv) {
   dynet::Model model;
   ParserStateBuilder * state_builder = get_state_builder(conf, model, *sys, corpus, pretrained);
 
-  corpus.load_devel_data(conf["devel_data"].as<std::string>(), allow_partial_tree);
+  {
+    TraceSpan span("load_devel_data", true);
+    corpus.load_devel_data(conf["devel_data"].as<std::string>(), allow_partial_tree);
+  }
   _INFO << "Main:: after loading development data, size(vocabulary)=" << corpus.word_map.size();
 
   std::string output;
@@ -160,6 +177,7 @@ int main(int argc, char** argv) {
     dynet::load_dynet_model(model_name, (&model));
     evaluate(conf, corpus, *state_builder, output);
   }
+  Tracer::instance().dump();
   return 0;
 }
 
@@ -12,6 +12,7 @@ po::options_description EnsembleStaticDataGenerator::get_options() {
     ("static_ensemble_rollin", po::value<std::string>()->default_value("expert"), "The type of rollin policy [expert|egreedy|boltzmann].")
     ("static_ensemble_egreedy_epsilon", po::value<float>()->default_value(0.1f), "The epsilon for epsilon-greedy policy.")
     ("static_ensemble_boltzmann_temperature", po::value<float>()->default_value(1.f), "The epsilon for epsilon-greedy policy.")
+    ("supervised_drop_forced", "Write the transitions with a single valid action without scoring them, and leave them out of the loss.")
     ;
   return cmd;
 }
@@ -53,6 +54,7 @@ EnsembleStaticDataGenerator::EnsembleStaticDataGenerator(const po::variables_map
     temperature = conf["static_ensemble_boltzmann_temperature"].as<float>();
     _INFO << "GEN:: temperature for boltzmann policy: " << temperature;
   }
+  drop_forced = (conf.count("supervised_drop_forced") > 0);
 }
 
 void EnsembleStaticDataGenerator::generate(const po::variables_map & conf,
@@ -68,6 +70,7 @@ void EnsembleStaticDataGenerator::generate(const po::variables_map & conf,
 
   std::ofstream ofs(output);
   ofs << "num_actions=" << system.num_actions() << std::endl;
+  for (ParserStateBuilder * state_builder : pretrained_state_builders) { state_builder->set_inference_mode(true); }
   for (unsigned sid = 0; sid < corpus.n_devel; ++sid) {
     InputUnits& input_units = corpus.devel_inputs[sid];
     const ParseUnits& parse_units = corpus.devel_parses[sid];
@@ -103,6 +106,20 @@ void EnsembleStaticDataGenerator::generate(const po::variables_map & conf,
         system.get_valid_actions(transition_state, valid_actions);
 
         std::vector<float> ensembled_probs(system.num_actions(), 0.f);
+        if (drop_forced && valid_actions.size() == 1) {
+          // the trainer drops the step, the ensemble restricted to the valid action is written.
+          unsigned action = valid_actions[0];
+          ensembled_probs[action] = 1.f;
+          ofs << action;
+          for (float s : ensembled_probs) { ofs << " " << s; }
+          ofs << std::endl;
+          system.perform_action(transition_state, action);
+          for (ParserState * ensembled_parser_state : ensembled_parser_states) {
+            ensembled_parser_state->perform_action(action, cg, transition_state);
+          }
+          n_actions++;
+          continue;
+        }
         for (ParserState* ensembled_parser_state : ensembled_parser_states) {
           dynet::Expression ensembled_score_exprs = ensembled_parser_state->get_scores();
           std::vector<float> ensembled_score = dynet::as_vector(cg.get_value(ensembled_score_exprs));
@@ -163,4 +180,5 @@ void EnsembleStaticDataGenerator::generate(const po::variables_map & conf,
       _INFO << "GEN:: finished " << epoch << " data.";
     }
   }
+  for (ParserStateBuilder * state_builder : pretrained_state_builders) { state_builder->set_inference_mode(false); }
 }
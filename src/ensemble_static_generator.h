@@ -18,6 +18,7 @@ struct EnsembleStaticDataGenerator {
   float temperature;
   unsigned n_sample;
   unsigned n_pretrained;
+  bool drop_forced;
   
   static po::options_description get_options();
 
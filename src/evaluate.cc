@@ -1,17 +1,192 @@
 #include "evaluate.h"
 #include "logging.h"
 #include "sys_utils.h"
+#include "trace.h"
+#include "math_utils.h"
+#include "memory_utils.h"
 #include <fstream>
+#include <sstream>
 #include <chrono>
+#include <climits>
+
+/* Per-sentence decoding latency, overall and by sentence length. */
+struct DecodeLatency {
+  static const unsigned kNumLengthBuckets = 5;
+  static const unsigned kLengthBounds[kNumLengthBuckets];
+  LatencyHistogram overall;
+  LatencyHistogram by_length[kNumLengthBuckets];
+
+  void push(unsigned len, double ms) {
+    overall.push(ms);
+    unsigned i = 0;
+    while (i + 1 < kNumLengthBuckets && len > kLengthBounds[i]) { ++i; }
+    by_length[i].push(ms);
+  }
+
+  /* Log the summary as one line of json. */
+  void report(const std::string & decoder) const {
+    std::ostringstream os;
+    os << "{\"decoder\":\"" << decoder << "\",\"unit\":\"ms\",\"overall\":"
+      << overall.to_json() << ",\"by_length\":{";
+    for (unsigned i = 0, lower = 1; i < kNumLengthBuckets; lower = kLengthBounds[i] + 1, ++i) {
+      if (i > 0) { os << ","; }
+      os << "\"" << lower << "-";
+      if (i + 1 < kNumLengthBuckets) { os << kLengthBounds[i]; }
+      os << "\":" << by_length[i].to_json();
+    }
+    os << "}}";
+    _INFO << "Latency:: " << os.str();
+  }
+};
+
+const unsigned DecodeLatency::kLengthBounds[] = { 10, 20, 40, 80, UINT_MAX };
+
+void greedy_decode(dynet::ComputationGraph & cg,
+                   ParserStateBuilder & state_builder,
+                   InputUnits & input_units,
+                   ParseUnits & result,
+                   bool params_in_graph) {
+  TransitionSystem & system = state_builder.system;
+  ParserState * parser_state = state_builder.build();
+  if (!params_in_graph) { parser_state->new_graph(cg); }
+  {
+    TraceSpan span("initialize");
+    parser_state->initialize(cg, input_units);
+  }
+
+  unsigned len = input_units.size();
+  TransitionState transition_state(len);
+  transition_state.initialize(input_units);
+
+  while (!transition_state.terminated()) {
+    std::vector<unsigned> valid_actions;
+    system.get_decoding_actions(transition_state, input_units, valid_actions);
+
+    TraceSpan span("get_scores");
+    unsigned best_a = valid_actions[0];
+    // a forced move is performed without scoring.
+    if (valid_actions.size() > 1) {
+      dynet::Expression score_exprs = parser_state->get_scores();
+      span.next("get_value");
+      std::vector<float> scores = dynet::as_vector(cg.get_value(score_exprs));
+      best_a = ParserState::get_best_action(scores, valid_actions).first;
+    }
+    span.next("perform_action");
+    system.perform_action(transition_state, best_a);
+    parser_state->perform_action(best_a, cg, transition_state);
+  }
+  delete parser_state;
+  vector_to_parse(transition_state.heads, transition_state.deprels, result);
+}
+
+void beam_decode(dynet::ComputationGraph & cg,
+                 ParserStateBuilder & state_builder,
+                 InputUnits & input_units,
+                 unsigned beam_size,
+                 bool structure,
+                 ParseUnits & result,
+                 bool params_in_graph) {
+  typedef std::tuple<unsigned, unsigned, float> Transition;
+  TransitionSystem & system = state_builder.system;
+
+  std::vector<TransitionState> transition_states;
+  std::vector<float> scores;
+  std::vector<ParserState *> parser_states;
+
+  parser_states.push_back(state_builder.build());
+  if (!params_in_graph) { parser_states[0]->new_graph(cg); }
+  {
+    TraceSpan span("initialize");
+    parser_states[0]->initialize(cg, input_units);
+  }
+
+  unsigned len = input_units.size();
+  transition_states.push_back(TransitionState(len));
+  transition_states[0].initialize(input_units);
+  scores.push_back(0.);
+
+  unsigned curr = 0, next = 1;
+  while (!transition_states[curr].terminated()) {
+    std::vector<Transition> transitions;
+    for (unsigned i = curr; i < next; ++i) {
+      const TransitionState & transition_state = transition_states[i];
+      float score = scores[i];
+
+      ParserState * parser_state = parser_states[i];
+
+      std::vector<unsigned> valid_actions;
+      system.get_decoding_actions(transition_state, input_units, valid_actions);
+
+      // when the beam holds a single item, a forced move shifts the score of
+      // every later item by the same amount, so it is made without scoring.
+      if (next - curr == 1 && valid_actions.size() == 1) {
+        transitions.push_back(std::make_tuple(i, valid_actions[0], score));
+        continue;
+      }
+      TraceSpan span("get_scores");
+      dynet::Expression score_exprs = parser_state->get_scores();
+      if (!structure) { score_exprs = dynet::log_softmax(score_exprs); }
+      span.next("get_value");
+      std::vector<float> s = dynet::as_vector(cg.get_value(score_exprs));
+      for (unsigned a : valid_actions) {
+        transitions.push_back(std::make_tuple(i, a, score + s[a]));
+      }
+    }
+
+    sort(transitions.begin(), transitions.end(),
+         [](const Transition& a, const Transition& b) { return std::get<2>(a) > std::get<2>(b); });
+    curr = next;
+
+    for (unsigned i = 0; i < transitions.size() && i < beam_size; ++i) {
+      unsigned cursor = std::get<0>(transitions[i]);
+      unsigned action = std::get<1>(transitions[i]);
+      float new_score = std::get<2>(transitions[i]);
+
+      TransitionState & transition_state = transition_states[cursor];
+      TransitionState new_transition_state(transition_state);
+      ParserState * parser_state = parser_states[cursor];
+      TraceSpan span("perform_action");
+      ParserState * new_parser_state = parser_state->copy();
+
+      if (action != system.num_actions()) {
+        system.perform_action(new_transition_state, action);
+        new_parser_state->perform_action(action, cg, new_transition_state);
+      }
+
+      transition_states.push_back(new_transition_state);
+      scores.push_back(new_score);
+      parser_states.push_back(new_parser_state);
+      next++;
+    }
+  }
+
+  for (ParserState * parser_state : parser_states) {
+    delete parser_state;
+  }
+  vector_to_parse(transition_states[curr].heads, transition_states[curr].deprels, result);
+}
+
+void new_reused_graph(dynet::ComputationGraph & cg, ParserStateBuilder & state_builder) {
+  state_builder.get_parser_model().new_graph(cg);
+  // the values of the parameter nodes should be allocated before the first
+  // checkpoint, otherwise revert() frees them while they are still marked
+  // as computed and the next sentence overwrites them.
+  if (!cg.nodes.empty()) { cg.incremental_forward(dynet::VariableIndex(cg.nodes.size() - 1)); }
+}
 
 float evaluate(const po::variables_map & conf,
                Corpus & corpus,
                ParserStateBuilder & state_builder,
                const std::string & output) {
-  TransitionSystem & system = state_builder.system;
+  TraceSpan trace_span("evaluate", true);
   auto t_start = std::chrono::high_resolution_clock::now();
   unsigned kUNK = corpus.get_or_add_word(Corpus::UNK);
+  DecodeLatency latency;
+  ArenaHighWater high_water;
   std::ofstream ofs(output);
+  state_builder.set_inference_mode(true);
+  dynet::ComputationGraph cg;
+  new_reused_graph(cg, state_builder);
 
   for (unsigned sid = 0; sid < corpus.n_devel; ++sid) {
     InputUnits& input_units = corpus.devel_inputs[sid];
@@ -21,31 +196,19 @@ float evaluate(const po::variables_map & conf,
       if (!corpus.training_vocab.count(u.wid)) { u.wid = kUNK; }
     }
     ParseUnits result;
-    ParserState * parser_state = state_builder.build();
-    dynet::ComputationGraph cg;
-    parser_state->new_graph(cg);
-    parser_state->initialize(cg, input_units);
-
-    unsigned len = input_units.size();
-    TransitionState transition_state(len);
-    transition_state.initialize(input_units);
-
-    while (!transition_state.terminated()) {
-      std::vector<unsigned> valid_actions;
-      system.get_valid_actions(transition_state, valid_actions);
-
-      dynet::Expression score_exprs = parser_state->get_scores();
-      std::vector<float> scores = dynet::as_vector(cg.get_value(score_exprs));
-    
-      auto payload = ParserState::get_best_action(scores, valid_actions);
-      unsigned best_a = payload.first;
-      system.perform_action(transition_state, best_a);
-      parser_state->perform_action(best_a, cg, transition_state);
+    Tracer::instance().next_sentence();
+    auto t_sent = std::chrono::high_resolution_clock::now();
+    if (!state_builder.native_greedy_decode(input_units, result)) {
+      cg.checkpoint();
+      greedy_decode(cg, state_builder, input_units, result, true);
+      high_water.sample();
+      cg.revert();
     }
-    delete parser_state;
+    unsigned len = input_units.size();
+    latency.push(len - 1, std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - t_sent).count());
 
     for (InputUnit& u : input_units) { u.wid = u.aux_wid; }
-    vector_to_parse(transition_state.heads, transition_state.deprels, result);
 
     // pay attention to this, not counting the last DUMMY_ROOT
     for (unsigned i = 0; i < len - 1; ++i) {
@@ -63,11 +226,14 @@ float evaluate(const po::variables_map & conf,
     }
     ofs << std::endl;
   }
+  state_builder.set_inference_mode(false);
   ofs.close();
   auto t_end = std::chrono::high_resolution_clock::now();
   float f_score = execute_and_get_result(conf["external_eval"].as<std::string>(), output);
   _INFO << "Evaluate:: UAS " << f_score << " [" << corpus.n_devel <<
     " sents in " << std::chrono::duration<double, std::milli>(t_end - t_start).count() << " ms]";
+  latency.report("greedy");
+  _INFO << "Evaluate:: arena high-water " << high_water.to_json();
   return f_score;
 }
 
@@ -78,9 +244,15 @@ float evaluate(const po::variables_map & conf,
   unsigned n_pretrained = pretrained_state_builders.size();
   assert(n_pretrained > 0);
   TransitionSystem & system = pretrained_state_builders[0]->system;
+  TraceSpan trace_span("evaluate", true);
   auto t_start = std::chrono::high_resolution_clock::now();
   unsigned kUNK = corpus.get_or_add_word(Corpus::UNK);
+  DecodeLatency latency;
+  ArenaHighWater high_water;
   std::ofstream ofs(output);
+  for (ParserStateBuilder * state_builder : pretrained_state_builders) { state_builder->set_inference_mode(true); }
+  dynet::ComputationGraph cg;
+  for (ParserStateBuilder * state_builder : pretrained_state_builders) { new_reused_graph(cg, *state_builder); }
 
   for (unsigned sid = 0; sid < corpus.n_devel; ++sid) {
     InputUnits& input_units = corpus.devel_inputs[sid];
@@ -91,10 +263,12 @@ float evaluate(const po::variables_map & conf,
     }
     ParseUnits result;
     std::vector<ParserState *> parser_states(n_pretrained);
-    dynet::ComputationGraph cg;
+    Tracer::instance().next_sentence();
+    auto t_sent = std::chrono::high_resolution_clock::now();
+    cg.checkpoint();
     for (unsigned i = 0; i < n_pretrained; ++i) {
       parser_states[i] = pretrained_state_builders[i]->build();
-      parser_states[i]->new_graph(cg);
+      TraceSpan span("initialize");
       parser_states[i]->initialize(cg, input_units);
     }
 
@@ -104,11 +278,14 @@ float evaluate(const po::variables_map & conf,
 
     while (!transition_state.terminated()) {
       std::vector<unsigned> valid_actions;
-      system.get_valid_actions(transition_state, valid_actions);
+      system.get_decoding_actions(transition_state, input_units, valid_actions);
 
       std::vector<float> scores;
       for (ParserState* parser_state : parser_states) {
+        if (valid_actions.size() == 1) { break; }
+        TraceSpan span("get_scores");
         dynet::Expression score_exprs = parser_state->get_scores();
+        span.next("get_value");
         std::vector<float> score = dynet::as_vector(cg.get_value(score_exprs));
         if (scores.size() == 0) {
           scores = score;
@@ -118,16 +295,22 @@ float evaluate(const po::variables_map & conf,
           }
         }
       }
-      auto payload = ParserState::get_best_action(scores, valid_actions);
-      unsigned best_a = payload.first;
+      unsigned best_a = (valid_actions.size() == 1 ?
+                         valid_actions[0] :
+                         ParserState::get_best_action(scores, valid_actions).first);
+      TraceSpan span("perform_action");
       system.perform_action(transition_state, best_a);
       for (ParserState * parser_state : parser_states) {
         parser_state->perform_action(best_a, cg, transition_state);
       }
     }
+    high_water.sample();
+    cg.revert();
     for (ParserState * parser_state : parser_states) {
       delete parser_state;
     }
+    latency.push(len - 1, std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - t_sent).count());
 
     for (InputUnit& u : input_units) { u.wid = u.aux_wid; }
     vector_to_parse(transition_state.heads, transition_state.deprels, result);
@@ -148,11 +331,14 @@ float evaluate(const po::variables_map & conf,
     }
     ofs << std::endl;
   }
+  for (ParserStateBuilder * state_builder : pretrained_state_builders) { state_builder->set_inference_mode(false); }
   ofs.close();
   auto t_end = std::chrono::high_resolution_clock::now();
   float f_score = execute_and_get_result(conf["external_eval"].as<std::string>(), output);
   _INFO << "Evaluate:: UAS " << f_score << " [" << corpus.n_devel <<
     " sents in " << std::chrono::duration<double, std::milli>(t_end - t_start).count() << " ms]";
+  latency.report("ensemble");
+  _INFO << "Evaluate:: arena high-water " << high_water.to_json();
   return f_score;
 }
 
@@ -161,14 +347,18 @@ float beam_search(const po::variables_map & conf,
                   ParserStateBuilder & state_builder,
                   const std::string & output,
                   bool structure) {
-  typedef std::tuple<unsigned, unsigned, float> Transition;
-  TransitionSystem & system = state_builder.system;
+  TraceSpan trace_span("beam_search", true);
 
   auto t_start = std::chrono::high_resolution_clock::now();
   unsigned kUNK = corpus.get_or_add_word(Corpus::UNK);
   unsigned beam_size = conf["beam_size"].as<unsigned>();
+  DecodeLatency latency;
+  ArenaHighWater high_water;
 
   std::ofstream ofs(output);
+  state_builder.set_inference_mode(true);
+  dynet::ComputationGraph cg;
+  new_reused_graph(cg, state_builder);
   for (unsigned sid = 0; sid < corpus.n_devel; ++sid) {
     InputUnits& input_units = corpus.devel_inputs[sid];
     const ParseUnits& parse = corpus.devel_parses[sid];
@@ -177,75 +367,18 @@ float beam_search(const po::variables_map & conf,
       if (!corpus.training_vocab.count(u.wid)) { u.wid = kUNK; }
     }
 
-    std::vector<TransitionState> transition_states;
-    std::vector<float> scores;
-    std::vector<ParserState *> parser_states;
-
-    parser_states.push_back(state_builder.build());
-    dynet::ComputationGraph cg;
-    parser_states[0]->new_graph(cg);
-    parser_states[0]->initialize(cg, input_units);
-
+    ParseUnits result;
+    Tracer::instance().next_sentence();
+    auto t_sent = std::chrono::high_resolution_clock::now();
+    cg.checkpoint();
+    beam_decode(cg, state_builder, input_units, beam_size, structure, result, true);
+    high_water.sample();
+    cg.revert();
     unsigned len = input_units.size();
-    transition_states.push_back(TransitionState(len));
-    transition_states[0].initialize(input_units);
-    
-    scores.push_back(0.);
-
-    unsigned curr = 0, next = 1;
-    while (!transition_states[curr].terminated()) {
-      std::vector<Transition> transitions;
-      for (unsigned i = curr; i < next; ++i) {
-        const TransitionState & transition_state = transition_states[i];
-        float score = scores[i];
-
-        ParserState * parser_state = parser_states[i];
-
-        std::vector<unsigned> valid_actions;
-        system.get_valid_actions(transition_state, valid_actions);
-      
-        dynet::Expression score_exprs = parser_state->get_scores();
-        if (!structure) { score_exprs = dynet::log_softmax(score_exprs); }
-        std::vector<float> s = dynet::as_vector(cg.get_value(score_exprs));
-        for (unsigned a : valid_actions) {
-          transitions.push_back(std::make_tuple(i, a, score + s[a]));
-        }
-      }
-
-      sort(transitions.begin(), transitions.end(),
-           [](const Transition& a, const Transition& b) { return std::get<2>(a) > std::get<2>(b); });
-      curr = next;
-
-      for (unsigned i = 0; i < transitions.size() && i < beam_size; ++i) {
-        unsigned cursor = std::get<0>(transitions[i]);
-        unsigned action = std::get<1>(transitions[i]);
-        float new_score = std::get<2>(transitions[i]);
-
-        TransitionState & transition_state = transition_states[cursor];
-        TransitionState new_transition_state(transition_state);
-        ParserState * parser_state = parser_states[cursor];
-        ParserState * new_parser_state = parser_state->copy();
-
-        if (action != system.num_actions()) {
-          system.perform_action(new_transition_state, action);
-          new_parser_state->perform_action(action, cg, new_transition_state);
-        }
-
-        transition_states.push_back(new_transition_state);
-        scores.push_back(new_score);
-        parser_states.push_back(new_parser_state);
-        next++;
-      }
-    }
-
-    for (ParserState * parser_state : parser_states) {
-      delete parser_state;
-    }
+    latency.push(len - 1, std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - t_sent).count());
 
     for (InputUnit& u : input_units) { u.wid = u.aux_wid; }
-    
-    ParseUnits result; 
-    vector_to_parse(transition_states[curr].heads, transition_states[curr].deprels, result);
 
     for (unsigned i = 0; i < len - 1; ++i) {
       ofs << i + 1 << "\t"                //  id
@@ -262,11 +395,14 @@ float beam_search(const po::variables_map & conf,
     }
     ofs << std::endl;
   }
+  state_builder.set_inference_mode(false);
   ofs.close();
   auto t_end = std::chrono::high_resolution_clock::now();
   float f_score = execute_and_get_result(conf["external_eval"].as<std::string>(), output);
   _INFO << "Evaluate:: UAS " << f_score << " [" << corpus.n_devel <<
     " sents in " << std::chrono::duration<double, std::milli>(t_end - t_start).count() << " ms]";
+  latency.report("beam");
+  _INFO << "Evaluate:: arena high-water " << high_water.to_json();
   return f_score;
 }
 
@@ -9,6 +9,30 @@
 
 namespace po = boost::program_options;
 
+/// Greedily parse one sentence on the given graph. The graph is left alive
+/// so that the caller can inspect it. If params_in_graph, the parameters of
+/// the model are already in the graph, see new_reused_graph.
+void greedy_decode(dynet::ComputationGraph & cg,
+                   ParserStateBuilder & state_builder,
+                   InputUnits & input_units,
+                   ParseUnits & result,
+                   bool params_in_graph = false);
+
+/// Parse one sentence with beam search on the given graph. The scores are
+/// locally normalized unless the model is trained with the structure loss.
+void beam_decode(dynet::ComputationGraph & cg,
+                 ParserStateBuilder & state_builder,
+                 InputUnits & input_units,
+                 unsigned beam_size,
+                 bool structure,
+                 ParseUnits & result,
+                 bool params_in_graph = false);
+
+/// Add the parameters of the model to a graph kept across sentences and
+/// compute them. Each sentence is then built after cg.checkpoint() and
+/// discarded with cg.revert(), so the parameter nodes are only added once.
+void new_reused_graph(dynet::ComputationGraph & cg, ParserStateBuilder & state_builder);
+
 float evaluate(const po::variables_map & conf,
                Corpus & corpus,
                ParserStateBuilder & state_builder,
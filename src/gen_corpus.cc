@@ -0,0 +1,117 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include "corpus.h"
+#include "tree.h"
+#include "logging.h"
+#include "synthetic.h"
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+void init_command_line(int argc, char* argv[], po::variables_map& conf) {
+  po::options_description general("Generate a synthetic treebank in the CoNLL format.");
+  general.add_options()
+    ("output,o", po::value<std::string>()->required(), "The path to the output file.")
+    ("sentences", po::value<unsigned>()->default_value(10000), "The number of sentences.")
+    ("vocab", po::value<unsigned>()->default_value(50000), "The size of the vocabulary.")
+    ("zipf", po::value<double>()->default_value(1.), "The exponent of the Zipf distribution of words.")
+    ("postags", po::value<unsigned>()->default_value(45), "The number of POS tags.")
+    ("deprels", po::value<unsigned>()->default_value(40), "The number of dependency relations, including root.")
+    ("length_distribution", po::value<std::string>()->default_value("lognormal"), "The distribution of sentence length [lognormal, uniform].")
+    ("mean_length", po::value<double>()->default_value(24.), "The mean sentence length of the lognormal distribution.")
+    ("length_sigma", po::value<double>()->default_value(0.6), "The sigma of the log sentence length.")
+    ("min_length", po::value<unsigned>()->default_value(1), "The minimum sentence length.")
+    ("max_length", po::value<unsigned>()->default_value(200), "The maximum sentence length.")
+    ("non_projective_ratio", po::value<float>()->default_value(0.f), "The ratio of non-projective trees.")
+    ("seed", po::value<unsigned>()->default_value(1), "The random seed.")
+    ("check", "Load the output with Corpus::load_training_data and check the trees.")
+    ("verbose,v", "Details logging.")
+    ("help,h", "show help information")
+    ;
+
+  po::store(po::parse_command_line(argc, argv, general), conf);
+  if (conf.count("help")) {
+    std::cerr << general << std::endl;
+    exit(1);
+  }
+  init_boost_log(conf.count("verbose") > 0);
+  po::notify(conf);
+}
+
+/* Check that the output loads as training data and every sentence is a tree. */
+bool check(const std::string & path, unsigned n_sentences) {
+  Corpus corpus;
+  Embeddings pretrained;
+  corpus.load_empty_embeddings(1, pretrained);
+  corpus.load_training_data(path, false);
+  corpus.stat();
+
+  unsigned n_not_tree = 0, n_non_projective = 0, max_length = 0;
+  for (unsigned sid = 0; sid < corpus.n_train; ++sid) {
+    const ParseUnits & parse_units = corpus.training_parses[sid];
+    if (!DependencyUtils::is_tree(parse_units)) {
+      ++n_not_tree;
+    } else if (DependencyUtils::is_non_projective(parse_units)) {
+      ++n_non_projective;
+    }
+    max_length = std::max(max_length, unsigned(parse_units.size() - 1));
+  }
+  _INFO << "GenCorpus:: " << corpus.n_train << " sentences loaded, " << n_not_tree << " not trees, "
+    << n_non_projective << " non-projective, max length " << max_length;
+  return (corpus.n_train == n_sentences && n_not_tree == 0);
+}
+
+int main(int argc, char** argv) {
+  po::variables_map conf;
+  init_command_line(argc, argv, conf);
+
+  unsigned n_sentences = conf["sentences"].as<unsigned>();
+  unsigned min_length = std::max(conf["min_length"].as<unsigned>(), 1u);
+  unsigned max_length = std::max(conf["max_length"].as<unsigned>(), min_length);
+  std::string length_distribution = conf["length_distribution"].as<std::string>();
+  if (length_distribution != "lognormal" && length_distribution != "uniform") {
+    _ERROR << "GenCorpus:: Unknown length distribution: " << length_distribution;
+    exit(1);
+  }
+  // the mean of a lognormal distribution is exp(mu + sigma^2 / 2).
+  double sigma = conf["length_sigma"].as<double>();
+  double mu = std::log(std::max(conf["mean_length"].as<double>(), 1.)) - sigma * sigma / 2.;
+  std::lognormal_distribution<double> lognormal(mu, sigma);
+  std::uniform_int_distribution<unsigned> uniform(min_length, max_length);
+  std::bernoulli_distribution non_projective(conf["non_projective_ratio"].as<float>());
+
+  SyntheticCorpus synthetic(conf["vocab"].as<unsigned>(),
+                            conf["zipf"].as<double>(),
+                            conf["postags"].as<unsigned>(),
+                            conf["deprels"].as<unsigned>(),
+                            conf["seed"].as<unsigned>());
+  std::mt19937 gen(conf["seed"].as<unsigned>());
+
+  std::string output = conf["output"].as<std::string>();
+  std::ofstream ofs(output);
+  if (!ofs) {
+    _ERROR << "GenCorpus:: failed to open " << output;
+    exit(1);
+  }
+  unsigned long n_tokens = 0;
+  for (unsigned sid = 0; sid < n_sentences; ++sid) {
+    unsigned len;
+    if (length_distribution == "uniform") {
+      len = uniform(gen);
+    } else {
+      double x = std::round(lognormal(gen));
+      len = (x < min_length ? min_length : (x > max_length ? max_length : unsigned(x)));
+    }
+    ofs << synthetic.sentence(len, !non_projective(gen), gen) << std::endl;
+    n_tokens += len;
+  }
+  ofs.close();
+  _INFO << "GenCorpus:: wrote " << n_sentences << " sentences, " << n_tokens << " tokens to " << output;
+
+  if (conf.count("check") && !check(output, n_sentences)) {
+    _ERROR << "GenCorpus:: check failed.";
+    exit(1);
+  }
+  return 0;
+}
@@ -0,0 +1,135 @@
+#include "grad_allreduce.h"
+#include "logging.h"
+#include <cstring>
+#include <algorithm>
+
+static size_t aligned_bytes(size_t n) {
+  return (n + 31) / 32 * 32;
+}
+
+GradientAllReducer::GradientAllReducer(dynet::ParameterCollection & model,
+                                       unsigned n_replicas) :
+  model(model),
+  n_replicas(n_replicas),
+  slot_size(0),
+  shm_size(0),
+  shm(nullptr) {
+  // layout of one slot: the dense gradients of the parameters, then for each
+  // lookup parameter the number of touched rows, their ids and their gradients.
+  for (auto & p : model.parameters_list()) {
+    param_offsets.push_back(slot_size);
+    slot_size += aligned_bytes(p->g.d.size() * sizeof(float));
+  }
+  for (auto & p : model.lookup_parameters_list()) {
+    lookup_offsets.push_back(slot_size);
+    unsigned n_rows = p->values.size();
+    slot_size += aligned_bytes(sizeof(unsigned) * (n_rows + 1));
+    slot_size += aligned_bytes(sizeof(float) * p->all_grads.d.size());
+  }
+  size_t head_size = aligned_bytes(sizeof(Header)) + aligned_bytes(sizeof(float) * n_replicas);
+  shm_size = head_size + slot_size * n_replicas;
+  // pages of the slots are only backed when touched, so the rows of the
+  // lookup parameters that are never updated cost nothing.
+  shm = static_cast<char *>(shm_alloc(shm_size));
+  if (shm == nullptr) {
+    _ERROR << "AllReduce:: failed to allocate " << shm_size << " bytes.";
+    exit(1);
+  }
+  header()->barrier.init(n_replicas);
+  _INFO << "AllReduce:: " << n_replicas << " replicas, " << slot_size << " bytes per slot.";
+}
+
+GradientAllReducer::~GradientAllReducer() {
+  if (shm != nullptr) {
+    header()->barrier.destroy();
+    shm_free(shm, shm_size);
+  }
+}
+
+GradientAllReducer::Header * GradientAllReducer::header() {
+  return reinterpret_cast<Header *>(shm);
+}
+
+float * GradientAllReducer::losses() {
+  return reinterpret_cast<float *>(shm + aligned_bytes(sizeof(Header)));
+}
+
+char * GradientAllReducer::slot(unsigned rank) {
+  size_t head_size = aligned_bytes(sizeof(Header)) + aligned_bytes(sizeof(float) * n_replicas);
+  return shm + head_size + slot_size * rank;
+}
+
+float GradientAllReducer::all_reduce(unsigned rank, float loss) {
+  const auto & params = model.parameters_list();
+  const auto & lookup_params = model.lookup_parameters_list();
+
+  // write the local gradients into the slot of this replica.
+  char * mine = slot(rank);
+  for (unsigned i = 0; i < params.size(); ++i) {
+    const dynet::Tensor & g = params[i]->g;
+    std::memcpy(mine + param_offsets[i], g.v, sizeof(float) * g.d.size());
+  }
+  for (unsigned i = 0; i < lookup_params.size(); ++i) {
+    dynet::LookupParameterStorage & p = *lookup_params[i];
+    unsigned dim = p.dim.size();
+    unsigned n_rows = p.values.size();
+    unsigned * count = reinterpret_cast<unsigned *>(mine + lookup_offsets[i]);
+    unsigned * ids = count + 1;
+    float * rows = reinterpret_cast<float *>(
+      mine + lookup_offsets[i] + aligned_bytes(sizeof(unsigned) * (n_rows + 1)));
+    unsigned n = 0;
+    if (p.all_updated) {
+      for (unsigned r = 0; r < n_rows; ++r) { ids[n++] = r; }
+    } else {
+      for (unsigned r : p.non_zero_grads) { ids[n++] = r; }
+    }
+    for (unsigned j = 0; j < n; ++j) {
+      std::memcpy(rows + j * dim, p.grads[ids[j]].v, sizeof(float) * dim);
+    }
+    (*count) = n;
+  }
+  losses()[rank] = loss;
+  header()->barrier.wait();
+
+  // sum all the slots in the order of ranks.
+  for (unsigned i = 0; i < params.size(); ++i) {
+    dynet::Tensor & g = params[i]->g;
+    size_t size = g.d.size();
+    std::fill(g.v, g.v + size, 0.f);
+    for (unsigned k = 0; k < n_replicas; ++k) {
+      const float * src = reinterpret_cast<const float *>(slot(k) + param_offsets[i]);
+      for (size_t j = 0; j < size; ++j) { g.v[j] += src[j]; }
+    }
+  }
+  for (unsigned i = 0; i < lookup_params.size(); ++i) {
+    dynet::LookupParameterStorage & p = *lookup_params[i];
+    unsigned dim = p.dim.size();
+    unsigned n_rows = p.values.size();
+    // zero the touched rows first so that every replica sums in the same order.
+    for (unsigned k = 0; k < n_replicas; ++k) {
+      const unsigned * count = reinterpret_cast<const unsigned *>(slot(k) + lookup_offsets[i]);
+      const unsigned * ids = count + 1;
+      for (unsigned j = 0; j < (*count); ++j) { p.non_zero_grads.insert(ids[j]); }
+    }
+    for (unsigned r : p.non_zero_grads) {
+      std::fill(p.grads[r].v, p.grads[r].v + dim, 0.f);
+    }
+    for (unsigned k = 0; k < n_replicas; ++k) {
+      const char * base = slot(k) + lookup_offsets[i];
+      const unsigned * count = reinterpret_cast<const unsigned *>(base);
+      const unsigned * ids = count + 1;
+      const float * rows = reinterpret_cast<const float *>(
+        base + aligned_bytes(sizeof(unsigned) * (n_rows + 1)));
+      for (unsigned j = 0; j < (*count); ++j) {
+        float * dst = p.grads[ids[j]].v;
+        const float * src = rows + j * dim;
+        for (unsigned d = 0; d < dim; ++d) { dst[d] += src[d]; }
+      }
+    }
+  }
+  float ret = 0.f;
+  for (unsigned k = 0; k < n_replicas; ++k) { ret += losses()[k]; }
+  // no replica may write its slot again before all have read.
+  header()->barrier.wait();
+  return ret;
+}
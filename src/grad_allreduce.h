@@ -0,0 +1,41 @@
+#ifndef GRAD_ALLREDUCE_H
+#define GRAD_ALLREDUCE_H
+
+#include <iostream>
+#include <vector>
+#include "dynet/model.h"
+#include "shm_utils.h"
+
+/// Sum the gradients of the model replicas held by forked processes through
+/// a shared memory segment. Each replica writes its gradient into its own
+/// slot, then every replica sums all the slots in the order of ranks, so the
+/// replicas end up with bit-identical gradients and, after the same update,
+/// bit-identical parameters. Only the touched rows of the lookup parameters
+/// are exchanged. The reducer should be created before forking.
+struct GradientAllReducer {
+  struct Header {
+    ProcessBarrier barrier;
+  };
+
+  dynet::ParameterCollection & model;
+  unsigned n_replicas;
+  size_t slot_size;
+  size_t shm_size;
+  char * shm;
+  std::vector<size_t> param_offsets;
+  std::vector<size_t> lookup_offsets;
+
+  GradientAllReducer(dynet::ParameterCollection & model, unsigned n_replicas);
+
+  ~GradientAllReducer();
+
+  /// Return the sum of the loss of all the replicas, the summed gradient is
+  /// left in the parameters of the calling replica.
+  float all_reduce(unsigned rank, float loss);
+
+  Header * header();
+  char * slot(unsigned rank);
+  float * losses();
+};
+
+#endif  //  end for GRAD_ALLREDUCE_H
@@ -0,0 +1,68 @@
+#include "label_pruner.h"
+#include "logging.h"
+
+LabelPruner::LabelPruner(unsigned n_postags, unsigned n_deprels, unsigned min_count) :
+  n_postags(n_postags),
+  n_deprels(n_deprels),
+  min_count(std::max(min_count, 1u)),
+  counts(n_postags * n_postags * 2 * n_deprels, 0),
+  seen(n_postags * n_postags * 2, false) {
+}
+
+unsigned LabelPruner::key(unsigned hed_pos, unsigned mod_pos, bool left) const {
+  return (hed_pos * n_postags + mod_pos) * 2 + (left ? 1 : 0);
+}
+
+void LabelPruner::count(const InputUnits & input_units, const ParseUnits & parse_units) {
+  std::vector<unsigned> heads, deprels;
+  parse_to_vector(parse_units, heads, deprels);
+  for (unsigned mod = 0; mod < heads.size(); ++mod) {
+    unsigned hed = heads[mod];
+    // the dummy root and the unannotated words of partial trees.
+    if (hed >= input_units.size() || deprels[mod] >= n_deprels) { continue; }
+    unsigned hed_pos = input_units[hed].pid, mod_pos = input_units[mod].pid;
+    if (hed_pos >= n_postags || mod_pos >= n_postags) { continue; }
+    unsigned k = key(hed_pos, mod_pos, mod < hed);
+    unsigned & c = counts[k * n_deprels + deprels[mod]];
+    if (++c >= min_count) { seen[k] = true; }
+  }
+}
+
+void LabelPruner::build(const Corpus & corpus) {
+  for (unsigned sid = 0; sid < corpus.n_train; ++sid) {
+    count(corpus.training_inputs.at(sid), corpus.training_parses.at(sid));
+  }
+  unsigned n_seen = 0, n_kept = 0;
+  for (unsigned k = 0; k < seen.size(); ++k) {
+    if (!seen[k]) { continue; }
+    ++n_seen;
+    for (unsigned l = 0; l < n_deprels; ++l) {
+      if (counts[k * n_deprels + l] >= min_count) { ++n_kept; }
+    }
+  }
+  _INFO << "LabelPruner:: " << n_seen << " (head pos, modifier pos, direction) seen, "
+    << (n_seen > 0 ? float(n_kept) / n_seen : 0.f) << " of " << n_deprels << " labels kept on average.";
+}
+
+bool LabelPruner::allow(unsigned hed_pos, unsigned mod_pos, bool left, unsigned deprel) const {
+  if (hed_pos >= n_postags || mod_pos >= n_postags || deprel >= n_deprels) { return true; }
+  unsigned k = key(hed_pos, mod_pos, left);
+  return (!seen[k] || counts[k * n_deprels + deprel] >= min_count);
+}
+
+void LabelPruner::prune(const TransitionSystem & system,
+                        const TransitionState & state,
+                        const InputUnits & input_units,
+                        std::vector<unsigned> & valid_actions) const {
+  unsigned n = 0;
+  for (unsigned a : valid_actions) {
+    unsigned hed, mod, deprel;
+    if (system.get_arc(state, a, hed, mod, deprel) &&
+        !allow(input_units[hed].pid, input_units[mod].pid, mod < hed, deprel)) {
+      continue;
+    }
+    valid_actions[n++] = a;
+  }
+  // keep the actions as is rather than leaving none.
+  if (n > 0) { valid_actions.resize(n); }
+}
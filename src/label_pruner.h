@@ -0,0 +1,39 @@
+#ifndef LABEL_PRUNER_H
+#define LABEL_PRUNER_H
+
+#include <vector>
+#include "corpus.h"
+#include "system.h"
+
+/// The deprels seen in the training data between a head POS and a modifier
+/// POS in each direction. At decoding, the labeled actions whose arc never
+/// carried their label are removed from the valid actions. A (head POS,
+/// modifier POS, direction) without any label kept allows all the labels.
+struct LabelPruner {
+  unsigned n_postags;
+  unsigned n_deprels;
+  unsigned min_count;
+  /// the counts of (head POS, modifier POS, direction, deprel), flattened.
+  std::vector<unsigned> counts;
+  /// if any label of (head POS, modifier POS, direction) reaches min_count.
+  std::vector<bool> seen;
+
+  LabelPruner(unsigned n_postags, unsigned n_deprels, unsigned min_count);
+
+  void count(const InputUnits & input_units, const ParseUnits & parse_units);
+
+  /// Count the training data of the corpus, and log the ratio of labels kept.
+  void build(const Corpus & corpus);
+
+  bool allow(unsigned hed_pos, unsigned mod_pos, bool left, unsigned deprel) const;
+
+  void prune(const TransitionSystem & system,
+             const TransitionState & state,
+             const InputUnits & input_units,
+             std::vector<unsigned> & valid_actions) const;
+
+private:
+  unsigned key(unsigned hed_pos, unsigned mod_pos, bool left) const;
+};
+
+#endif  //  end for LABEL_PRUNER_H
@@ -0,0 +1,59 @@
+#include "lstm_utils.h"
+
+// the order of the parameters of each layer in CoupledLSTMBuilder::param_vars.
+enum { X2I, H2I, C2I, BI, X2O, H2O, C2O, BO, X2C, H2C, BC };
+
+void add_inputs(dynet::CoupledLSTMBuilder & lstm,
+                const std::vector<dynet::Expression> & inputs,
+                std::vector<dynet::Expression> & outputs) {
+  unsigned n_steps = inputs.size();
+  outputs.clear();
+  if (n_steps < 2) {
+    for (const dynet::Expression & x : inputs) { outputs.push_back(lstm.add_input(x)); }
+    return;
+  }
+
+  unsigned n_layers = lstm.layers;
+  // the cells of all the layers followed by their outputs.
+  std::vector<dynet::Expression> prev_s = lstm.get_s(lstm.state());
+  std::vector<std::vector<dynet::Expression>> s(n_steps, std::vector<dynet::Expression>(n_layers * 2));
+  std::vector<dynet::Expression> layer_inputs = inputs;
+  for (unsigned l = 0; l < n_layers; ++l) {
+    const std::vector<dynet::Expression> & vars = lstm.param_vars[l];
+    // one batch element per step.
+    dynet::Expression x = dynet::concatenate_to_batch(layer_inputs);
+    dynet::Expression i_x = dynet::affine_transform({ vars[BI], vars[X2I], x });
+    dynet::Expression o_x = dynet::affine_transform({ vars[BO], vars[X2O], x });
+    dynet::Expression w_x = dynet::affine_transform({ vars[BC], vars[X2C], x });
+
+    bool has_prev = !prev_s.empty();
+    dynet::Expression c_prev, h_prev;
+    if (has_prev) { c_prev = prev_s[l]; h_prev = prev_s[l + n_layers]; }
+    for (unsigned t = 0; t < n_steps; ++t) {
+      dynet::Expression i_t, w_t, c_t, o_t;
+      if (has_prev) {
+        i_t = dynet::logistic(dynet::affine_transform({
+          dynet::pick_batch_elem(i_x, t), vars[H2I], h_prev, vars[C2I], c_prev }));
+        w_t = dynet::tanh(dynet::affine_transform({ dynet::pick_batch_elem(w_x, t), vars[H2C], h_prev }));
+        c_t = dynet::cmult(1.f - i_t, c_prev) + dynet::cmult(i_t, w_t);
+        o_t = dynet::logistic(dynet::affine_transform({
+          dynet::pick_batch_elem(o_x, t), vars[H2O], h_prev, vars[C2O], c_t }));
+      } else {
+        i_t = dynet::logistic(dynet::pick_batch_elem(i_x, t));
+        w_t = dynet::tanh(dynet::pick_batch_elem(w_x, t));
+        c_t = dynet::cmult(i_t, w_t);
+        o_t = dynet::logistic(dynet::affine_transform({ dynet::pick_batch_elem(o_x, t), vars[C2O], c_t }));
+      }
+      c_prev = c_t;
+      h_prev = dynet::cmult(o_t, dynet::tanh(c_t));
+      has_prev = true;
+      s[t][l] = c_prev;
+      s[t][l + n_layers] = h_prev;
+      layer_inputs[t] = h_prev;
+    }
+  }
+
+  for (unsigned t = 0; t < n_steps; ++t) {
+    outputs.push_back(lstm.set_s(lstm.state(), s[t]));
+  }
+}
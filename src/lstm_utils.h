@@ -0,0 +1,18 @@
+#ifndef LSTM_UTILS_H
+#define LSTM_UTILS_H
+
+#include <vector>
+#include "dynet/expr.h"
+#include "dynet/lstm.h"
+
+/// Feed the inputs to the LSTM after its current state, the same as calling
+/// add_input on each of them. The input projections of all the steps are
+/// computed as one batched product per layer, so only the recurrent part runs
+/// step by step. The states are registered in the builder, so the pointers
+/// still work afterwards. The outputs of the last layer are put in outputs.
+/// The dropout of the builder is not applied, the parsers never set it.
+void add_inputs(dynet::CoupledLSTMBuilder & lstm,
+                const std::vector<dynet::Expression> & inputs,
+                std::vector<dynet::Expression> & outputs);
+
+#endif  //  end for LSTM_UTILS_H
@@ -11,6 +11,12 @@
 #include "train_supervised.h"
 #include "sys_utils.h"
 #include "trainer_utils.h"
+#include "async_evaluator.h"
+#include "trace.h"
+#include "model_profiler.h"
+#include "memory_utils.h"
+#include <algorithm>
+#include <cmath>
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string.hpp>
 
@@ -37,16 +43,21 @@ void init_command_line(int argc, char* argv[], po::variables_map& conf) {
     ("label_dim", po::value<unsigned>()->default_value(20), "The dimension for label.")
     ("lstm_input_dim", po::value<unsigned>()->default_value(100), "The dimension for lstm input.")
     ("hidden_dim", po::value<unsigned>()->default_value(100), "The dimension for hidden unit.")
+    ("char_cache_size", po::value<unsigned>()->default_value(50000), "The number of word types whose char-LSTM vector is cached at inference (ballesteros15), 0 to disable.")
+    ("char_cache_precompute", "Precompute the char-LSTM vectors of the training vocabulary when entering inference (ballesteros15).")
+    ("input_cache_size", po::value<unsigned>()->default_value(100000), "The number of (word, pos, pretrained) inputs whose merged vector is cached at inference (dyer15, kiperwasser16), 0 to disable.")
+    ("native_inference", "Decode with the graph-free engine in the greedy evaluation (dyer15).")
     ("dropout", po::value<float>()->default_value(0.f), "The dropout rate.")
     ("max_iter", po::value<unsigned>()->default_value(10), "The maximum number of iteration.")
     ("report_stops", po::value<unsigned>()->default_value(100), "The reporting stops")
     ("evaluate_stops", po::value<unsigned>()->default_value(2500), "The evaluation stops")
     ("evaluate_skips", po::value<unsigned>()->default_value(0), "skip evaluation on the first n round.")
     ("external_eval", po::value<std::string>()->default_value("python ./script/eval.py"), "config the path for evaluation script")
-    ("lambda", po::value<float>()->default_value(0.), "The L2 regularizer, should not set in --dynet-l2.")
     ("output", po::value<std::string>(), "The path to the output file.")
     ("beam_size", po::value<unsigned>(), "The beam size.")
     ("partial", po::value<bool>()->default_value(false), "The input data contains partial annotation.")
+    ("dynet_mem_auto_sentences", po::value<unsigned>()->default_value(5), "The number of longest training and development sentences for sizing `--dynet-mem auto`.")
+    ("profile_model", "Report the parameters, estimated FLOPs and graph size of each model component, then exit.")
     ("verbose,v", "Details logging.")
     ("help,h", "show help information")
     ;
@@ -54,6 +65,9 @@ void init_command_line(int argc, char* argv[], po::variables_map& conf) {
   po::options_description system_opt = TransitionSystemBuilder::get_options();
   po::options_description noisify_opt = Noisifier::get_options();
   po::options_description optimizer_opt = get_optimizer_options();
+  po::options_description regularizer_opt = L2Regularizer::get_options();
+  po::options_description evaluate_opt = AsyncEvaluator::get_options();
+  po::options_description trace_opt = Tracer::get_options();
   po::options_description supervise_opt = SupervisedTrainer::get_options();
 
   po::options_description cmd("Allowed options");
@@ -61,6 +75,9 @@ void init_command_line(int argc, char* argv[], po::variables_map& conf) {
     .add(system_opt)
     .add(noisify_opt)
     .add(optimizer_opt)
+    .add(regularizer_opt)
+    .add(evaluate_opt)
+    .add(trace_opt)
     .add(supervise_opt)
     ;
 
@@ -76,7 +93,100 @@ void init_command_line(int argc, char* argv[], po::variables_map& conf) {
   }
 }
 
+/* Size the dynet pools from a dry run on the longest training and development
+ * sentences: forward and backward of the training objective, and decoding at
+ * the configured beam. The program is then restarted with the measured sizes. */
+static void auto_dynet_mem(const po::variables_map & conf,
+                           Corpus & corpus,
+                           const Noisifier & noisifier,
+                           ParserStateBuilder & state_builder,
+                           dynet::ParameterCollection & model,
+                           bool allow_non_projective,
+                           bool allow_partial_tree,
+                           const std::vector<std::string> & args) {
+  const double kMargin = 1.25;
+  const double kMB = 1048576.;
+  const unsigned kMinMB = 16;
+  unsigned n_probe = conf["dynet_mem_auto_sentences"].as<unsigned>();
+  unsigned beam_size = (conf.count("beam_size") ? conf["beam_size"].as<unsigned>() : 1);
+  bool structure = (conf["supervised_objective"].as<std::string>() == "structure");
+  size_t max_fxs = 0, max_dedfs = 0;
+
+  if (conf.count("train")) {
+    std::vector<unsigned> order;
+    get_orders(corpus, order, allow_non_projective, allow_partial_tree);
+    std::sort(order.begin(), order.end(), [&corpus](unsigned a, unsigned b) {
+      return corpus.training_inputs[a].size() > corpus.training_inputs[b].size();
+    });
+    if (order.size() > n_probe) { order.resize(n_probe); }
+
+    SupervisedTrainer trainer(conf, noisifier, state_builder);
+    for (unsigned sid : order) {
+      const InputUnits & input_units = corpus.training_inputs[sid];
+      const ParseUnits & parse_units = corpus.training_parses[sid];
+      if (allow_partial_tree) {
+        trainer.train_partial_tree(input_units, parse_units, 0);
+      } else {
+        trainer.train_full_tree(input_units, parse_units, 0);
+        if (structure && beam_size > 1) {
+          trainer.train_structure_full_tree(input_units, parse_units, beam_size, 0);
+        }
+      }
+    }
+    max_fxs = trainer.stats.high_water.max_fxs;
+    max_dedfs = trainer.stats.high_water.max_dedfs;
+    model.reset_gradient();
+  }
+
+  std::vector<unsigned> devel_order(corpus.n_devel);
+  for (unsigned sid = 0; sid < corpus.n_devel; ++sid) { devel_order[sid] = sid; }
+  std::sort(devel_order.begin(), devel_order.end(), [&corpus](unsigned a, unsigned b) {
+    return corpus.devel_inputs[a].size() > corpus.devel_inputs[b].size();
+  });
+  if (devel_order.size() > n_probe) { devel_order.resize(n_probe); }
+
+  unsigned kUNK = corpus.get_or_add_word(Corpus::UNK);
+  ArenaHighWater high_water;
+  for (unsigned sid : devel_order) {
+    InputUnits & input_units = corpus.devel_inputs[sid];
+    for (InputUnit & u : input_units) {
+      if (!corpus.training_vocab.count(u.wid)) { u.wid = kUNK; }
+    }
+    ParseUnits result;
+    dynet::ComputationGraph cg;
+    if (beam_size > 1) {
+      beam_decode(cg, state_builder, input_units, beam_size, structure, result);
+    } else {
+      greedy_decode(cg, state_builder, input_units, result);
+    }
+    high_water.sample();
+    for (InputUnit & u : input_units) { u.wid = u.aux_wid; }
+  }
+  max_fxs = std::max(max_fxs, high_water.max_fxs);
+  max_dedfs = std::max(max_dedfs, high_water.max_dedfs);
+
+  // the parameter pool holds the values and the gradients, and the optimizer
+  // allocates its own states on the first update.
+  std::string optimizer = conf["optimizer"].as<std::string>();
+  double n_states = 0.;
+  if (optimizer == "momentum_sgd" || optimizer == "adagrad" || optimizer == "rmsprop") {
+    n_states = 1.;
+  } else if (optimizer == "adadelta" || optimizer == "adam") {
+    n_states = 2.;
+  }
+  double ps = arena_used_ps() * (conf.count("train") ? 1. + n_states / 2. : 1.);
+
+  unsigned fxs_mb = std::max(kMinMB, unsigned(std::ceil(max_fxs * kMargin / kMB)));
+  unsigned dedfs_mb = std::max(kMinMB, unsigned(std::ceil(max_dedfs * kMargin / kMB)));
+  unsigned ps_mb = std::max(kMinMB, unsigned(std::ceil(ps * kMargin / kMB)));
+  _INFO << "Memory:: high-water on the longest sentences fxs " << (max_fxs >> 20)
+    << " MB, dedfs " << (max_dedfs >> 20) << " MB, parameters " << (arena_used_ps() >> 20) << " MB.";
+  exec_with_dynet_mem(args, fxs_mb, dedfs_mb, ps_mb);
+}
+
 int main(int argc, char** argv) {
+  std::vector<std::string> original_args;
+  bool dynet_mem_auto = parse_dynet_mem_auto(argc, argv, original_args);
   dynet::initialize(argc, argv, false);
   std::cerr << "command:";
   for (int i = 0; i < argc; ++i) { std::cerr << ' ' << argv[i]; }
@@ -84,6 +194,7 @@ int main(int argc, char** argv) {
 
   po::variables_map conf;
   init_command_line(argc, argv, conf);
+  Tracer::instance().initialize(conf);
 
   std::string model_name;
   if (conf.count("train")) {
@@ -120,7 +231,10 @@ int main(int argc, char** argv) {
                                  pretrained);
   }
 
-  corpus.load_training_data(conf["training_data"].as<std::string>(), allow_partial_tree);
+  {
+    TraceSpan span("load_training_data", true);
+    corpus.load_training_data(conf["training_data"].as<std::string>(), allow_partial_tree);
+  }
   corpus.stat();
   corpus.get_vocabulary_and_word_count();
 
@@ -133,7 +247,10 @@ int main(int argc, char** argv) {
   Noisifier noisifier(conf, corpus);
   ParserStateBuilder * state_builder = get_state_builder(conf, model, (*sys), corpus, pretrained);
 
-  corpus.load_devel_data(conf["devel_data"].as<std::string>(), allow_partial_tree);
+  {
+    TraceSpan span("load_devel_data", true);
+    corpus.load_devel_data(conf["devel_data"].as<std::string>(), allow_partial_tree);
+  }
   _INFO << "Main:: after loading development data, size(vocabulary)=" << corpus.word_map.size();
 
   std::string output;
@@ -149,6 +266,17 @@ int main(int argc, char** argv) {
   }
   _INFO << "Main:: write tmp file to: " << output;
 
+  if (dynet_mem_auto) {
+    auto_dynet_mem(conf, corpus, noisifier, *state_builder, model,
+                   allow_non_projective, allow_partial_tree, original_args);
+  }
+
+  if (conf.count("profile_model")) {
+    profile_model(conf, corpus, *state_builder);
+    Tracer::instance().dump();
+    return 0;
+  }
+
   if (conf.count("train")) {
     SupervisedTrainer trainer(conf, noisifier, *state_builder);
     trainer.train(conf, corpus, model_name, output, allow_non_projective, allow_partial_tree);
@@ -161,6 +289,7 @@ int main(int argc, char** argv) {
   } else {
     evaluate(conf, corpus, *state_builder, output);
   }
+  Tracer::instance().dump();
   return 0;
 }
 
@@ -1,5 +1,7 @@
 #include "math_utils.h"
 #include <boost/assert.hpp>
+#include <sstream>
+#include <cmath>
 
 void MeanStdevStreamer::clear() { n = 0; }
 
@@ -22,6 +24,61 @@ double MeanStdevStreamer::mean()          const { return ((n > 0) ? new_m : 0.0)
 double MeanStdevStreamer::variance()      const { return ((n > 1) ? new_s / (n - 1) : 0.0); }
 double MeanStdevStreamer::stdev()         const { return sqrt(variance()); }
 
+const double LatencyHistogram::kMinValue = 1e-3;
+const double LatencyHistogram::kGrowth = 1.0905077326652577; // 2^(1/8)
+
+LatencyHistogram::LatencyHistogram() { clear(); }
+
+void LatencyHistogram::clear() {
+  counts.assign(kBuckets, 0);
+  max_value = 0.;
+  streamer.clear();
+}
+
+void LatencyHistogram::push(double x) {
+  unsigned i = 0;
+  if (x > kMinValue) {
+    i = static_cast<unsigned>(log(x / kMinValue) / log(kGrowth)) + 1;
+    if (i >= kBuckets) { i = kBuckets - 1; }
+  }
+  counts[i]++;
+  if (x > max_value) { max_value = x; }
+  streamer.push(x);
+}
+
+unsigned LatencyHistogram::size() const { return streamer.num_data_values(); }
+
+double LatencyHistogram::max() const { return max_value; }
+
+double LatencyHistogram::quantile(double q) const {
+  unsigned n = size();
+  if (n == 0) { return 0.; }
+  unsigned rank = static_cast<unsigned>(ceil(q * n));
+  if (rank == 0) { rank = 1; }
+  unsigned acc = 0;
+  for (unsigned i = 0; i < kBuckets; ++i) {
+    acc += counts[i];
+    if (acc >= rank) {
+      // report the upper bound of the bucket, but never beyond the maximum.
+      double upper = kMinValue * pow(kGrowth, i);
+      return (upper < max_value ? upper : max_value);
+    }
+  }
+  return max_value;
+}
+
+std::string LatencyHistogram::to_json() const {
+  std::ostringstream os;
+  os << "{\"n\":" << size()
+    << ",\"mean\":" << streamer.mean()
+    << ",\"stdev\":" << streamer.stdev()
+    << ",\"p50\":" << quantile(0.5)
+    << ",\"p95\":" << quantile(0.95)
+    << ",\"p99\":" << quantile(0.99)
+    << ",\"max\":" << max() << "}";
+  return os.str();
+}
+
 void mean_and_stddev(const std::deque<float>& data,
                      float& mean, float& stddev) {
   float n = 0.;
@@ -4,6 +4,7 @@
 #include <deque>
 #include <vector>
 #include <random>
+#include <string>
 
 struct MeanStdevStreamer {
   int n;
@@ -17,6 +18,27 @@ struct MeanStdevStreamer {
   double stdev()        const;
 };
 
+// Log-bucketed histogram of latencies (in ms), each bucket is 2^(1/8) times
+// wider than the previous one so a quantile is off by at most 9%.
+struct LatencyHistogram {
+  static const unsigned kBuckets = 256;
+  static const double kMinValue;
+  static const double kGrowth;
+
+  std::vector<unsigned> counts;
+  double max_value;
+  MeanStdevStreamer streamer;
+
+  LatencyHistogram();
+  void clear();
+  void push(double x);
+  unsigned size()                 const;
+  double quantile(double q)       const;
+  double max()                    const;
+  /// Write the summary as a json object.
+  std::string to_json()           const;
+};
+
 void mean_and_stddev(const std::deque<float>& data,
                      float& mean,
                      float& stddev);
@@ -0,0 +1,100 @@
+#include "memory_utils.h"
+#include "logging.h"
+#include "dynet/globals.h"
+#include "dynet/mem.h"
+#include "dynet/devices.h"
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+// the probing run can not know its needs beforehand, the pools are sized
+// large enough for very long sentences and wide beams (FXS,DEDFS,PS in MB).
+static const char * kProbeDynetMem = "4096,4096,2048";
+
+static size_t arena_used(dynet::DeviceMempool pool) {
+  dynet::Device * device = dynet::default_device;
+  if (device == nullptr) { return 0; }
+  return device->pools[(int)pool]->used();
+}
+
+size_t arena_used_fxs() { return arena_used(dynet::DeviceMempool::FXS); }
+
+size_t arena_used_dedfs() { return arena_used(dynet::DeviceMempool::DEDFS); }
+
+size_t arena_used_ps() { return arena_used(dynet::DeviceMempool::PS); }
+
+ArenaHighWater::ArenaHighWater() {
+  clear();
+}
+
+void ArenaHighWater::clear() {
+  n_samples = 0;
+  max_fxs = 0;
+  max_dedfs = 0;
+  last_fxs = 0;
+  last_dedfs = 0;
+}
+
+void ArenaHighWater::sample() {
+  last_fxs = arena_used_fxs();
+  last_dedfs = arena_used_dedfs();
+  max_fxs = std::max(max_fxs, last_fxs);
+  max_dedfs = std::max(max_dedfs, last_dedfs);
+  n_samples++;
+}
+
+std::string ArenaHighWater::to_json() const {
+  const double kMB = 1048576.;
+  std::ostringstream os;
+  os << "{\"unit\":\"MB\",\"n\":" << n_samples
+    << ",\"fxs\":{\"max\":" << max_fxs / kMB << ",\"last\":" << last_fxs / kMB << "}"
+    << ",\"dedfs\":{\"max\":" << max_dedfs / kMB << ",\"last\":" << last_dedfs / kMB << "}}";
+  return os.str();
+}
+
+static bool is_dynet_mem(const char * arg) {
+  return (strcmp(arg, "--dynet-mem") == 0 || strcmp(arg, "--dynet_mem") == 0);
+}
+
+bool parse_dynet_mem_auto(int argc, char ** argv, std::vector<std::string> & args) {
+  bool found = false;
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (is_dynet_mem(argv[i]) && strcmp(argv[i + 1], "auto") == 0) {
+      argv[i + 1] = const_cast<char *>(kProbeDynetMem);
+      found = true;
+    }
+  }
+  if (!found) { return false; }
+  args.clear();
+  for (int i = 0; i < argc; ++i) {
+    args.push_back(i > 0 && argv[i] == kProbeDynetMem ? std::string("auto") : std::string(argv[i]));
+  }
+  return true;
+}
+
+void exec_with_dynet_mem(const std::vector<std::string> & args,
+                         unsigned fxs_mb, unsigned dedfs_mb, unsigned ps_mb) {
+  std::ostringstream os;
+  os << fxs_mb << "," << dedfs_mb << "," << ps_mb;
+  std::string mem = os.str();
+  std::vector<std::string> new_args(args);
+  for (unsigned i = 1; i + 1 < new_args.size(); ++i) {
+    if (is_dynet_mem(new_args[i].c_str()) && new_args[i + 1] == "auto") { new_args[i + 1] = mem; }
+  }
+  _INFO << "Memory:: restart with --dynet-mem " << mem;
+#ifndef _MSC_VER
+  std::vector<char *> argv;
+  for (std::string & arg : new_args) { argv.push_back(const_cast<char *>(arg.c_str())); }
+  argv.push_back(nullptr);
+  std::cerr.flush();
+  execv("/proc/self/exe", argv.data());
+  execvp(argv[0], argv.data());
+  _WARN << "Memory:: failed to restart (" << strerror(errno) << "), continue with the probing sizes.";
+#else
+  _WARN << "Memory:: restart is not supported on this platform, continue with the probing sizes.";
+#endif
+}
@@ -0,0 +1,40 @@
+#ifndef MEMORY_UTILS_H
+#define MEMORY_UTILS_H
+
+#include <iostream>
+#include <vector>
+
+/// Bytes in use of the forward (FXS) and backward (DEDFS) arenas of the
+/// default device; they only grow while a graph is alive.
+size_t arena_used_fxs();
+size_t arena_used_dedfs();
+size_t arena_used_ps();
+
+/// The per-sentence high-water mark of the forward and backward arenas, the
+/// largest one and the last one. The arenas are reset with each graph, so one
+/// sample taken before the graph of a sentence is destroyed is its mark.
+struct ArenaHighWater {
+  unsigned n_samples;
+  size_t max_fxs;           // in bytes.
+  size_t max_dedfs;
+  size_t last_fxs;
+  size_t last_dedfs;
+
+  ArenaHighWater();
+  void clear();
+  void sample();
+  /// Write the summary as a json object.
+  std::string to_json() const;
+};
+
+/// Handle `--dynet-mem auto`: the original arguments are saved in args and
+/// the value is replaced in place by a generous probing size, so that
+/// dynet::initialize can parse it. Return false if the memory is not auto.
+bool parse_dynet_mem_auto(int argc, char ** argv, std::vector<std::string> & args);
+
+/// Restart the program with the saved arguments, `--dynet-mem auto` being
+/// replaced by the given pool sizes (in MB). Only return if exec failed.
+void exec_with_dynet_mem(const std::vector<std::string> & args,
+                         unsigned fxs_mb, unsigned dedfs_mb, unsigned ps_mb);
+
+#endif  //  end for MEMORY_UTILS_H
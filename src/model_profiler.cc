@@ -0,0 +1,112 @@
+#include "model_profiler.h"
+#include "parser.h"
+#include "logging.h"
+#include <iomanip>
+#include <sstream>
+
+ModelProfiler::ModelProfiler() : chars_per_token(0.) {
+}
+
+void ModelProfiler::add(const std::string & name, const dynet::LookupParameter & p) {
+  Component component;
+  component.name = name;
+  component.n_params = (unsigned long)(p.get_storage().values.size()) * p.dim().size();
+  component.flops_per_token = 0.;
+  component.flops_per_transition = 0.;
+  components.push_back(component);
+}
+
+void ModelProfiler::add(const std::string & name,
+                        const std::vector<dynet::Expression> & params,
+                        double calls_per_token,
+                        double calls_per_transition) {
+  Component component;
+  component.name = name;
+  component.n_params = 0;
+  for (const dynet::Expression & e : params) { component.n_params += e.dim().size(); }
+  component.flops_per_token = 2. * component.n_params * calls_per_token;
+  component.flops_per_transition = 2. * component.n_params * calls_per_transition;
+  components.push_back(component);
+}
+
+void ModelProfiler::add(const std::string & name,
+                        const dynet::CoupledLSTMBuilder & lstm,
+                        double calls_per_token,
+                        double calls_per_transition) {
+  std::vector<dynet::Expression> params;
+  for (auto & layer : lstm.param_vars) { for (auto & e : layer) { params.push_back(e); } }
+  add(name, params, calls_per_token, calls_per_transition);
+}
+
+void profile_model(const po::variables_map & conf,
+                   Corpus & corpus,
+                   ParserStateBuilder & state_builder) {
+  TransitionSystem & system = state_builder.system;
+  ModelProfiler profiler;
+
+  unsigned kUNK = corpus.get_or_add_word(Corpus::UNK);
+  unsigned long n_tokens = 0, n_chars = 0, n_transitions = 0, n_nodes = 0;
+  unsigned n_sentences = corpus.n_devel;
+  if (n_sentences == 0) {
+    _ERROR << "Profile:: no development data to profile on.";
+    return;
+  }
+  for (unsigned sid = 0; sid < n_sentences; ++sid) {
+    for (const InputUnit & u : corpus.devel_inputs[sid]) { n_chars += u.cids.size(); }
+    n_tokens += corpus.devel_inputs[sid].size();
+  }
+  profiler.chars_per_token = double(n_chars) / n_tokens;
+
+  for (unsigned sid = 0; sid < n_sentences; ++sid) {
+    InputUnits & input_units = corpus.devel_inputs[sid];
+    for (InputUnit & u : input_units) {
+      if (!corpus.training_vocab.count(u.wid)) { u.wid = kUNK; }
+    }
+    ParserState * parser_state = state_builder.build();
+    dynet::ComputationGraph cg;
+    parser_state->new_graph(cg);
+    if (sid == 0) { state_builder.get_parser_model().profile(profiler); }
+    parser_state->initialize(cg, input_units);
+
+    unsigned len = input_units.size();
+    TransitionState transition_state(len);
+    transition_state.initialize(input_units);
+    while (!transition_state.terminated()) {
+      std::vector<unsigned> valid_actions;
+      system.get_valid_actions(transition_state, valid_actions);
+      dynet::Expression score_exprs = parser_state->get_scores();
+      std::vector<float> scores = dynet::as_vector(cg.get_value(score_exprs));
+      unsigned best_a = ParserState::get_best_action(scores, valid_actions).first;
+      system.perform_action(transition_state, best_a);
+      parser_state->perform_action(best_a, cg, transition_state);
+      n_transitions++;
+    }
+    n_nodes += cg.nodes.size();
+    delete parser_state;
+    for (InputUnit & u : input_units) { u.wid = u.aux_wid; }
+  }
+  double transitions_per_token = double(n_transitions) / n_tokens;
+
+  _INFO << "Profile:: " << n_sentences << " sentences, " << n_tokens << " tokens, "
+    << n_transitions << " transitions, " << profiler.chars_per_token << " chars/token";
+  _INFO << "Profile:: " << std::setw(16) << "component" << std::setw(12) << "params"
+    << std::setw(12) << "bytes" << std::setw(16) << "flops/token" << std::setw(16) << "flops/trans";
+  unsigned long total_params = 0;
+  double total_flops_token = 0., total_flops_transition = 0.;
+  for (const ModelProfiler::Component & c : profiler.components) {
+    _INFO << "Profile:: " << std::setw(16) << c.name << std::setw(12) << c.n_params
+      << std::setw(12) << c.n_params * sizeof(float)
+      << std::setw(16) << c.flops_per_token << std::setw(16) << c.flops_per_transition;
+    total_params += c.n_params;
+    total_flops_token += c.flops_per_token;
+    total_flops_transition += c.flops_per_transition;
+  }
+  _INFO << "Profile:: " << std::setw(16) << "total" << std::setw(12) << total_params
+    << std::setw(12) << total_params * sizeof(float)
+    << std::setw(16) << total_flops_token << std::setw(16) << total_flops_transition;
+  _INFO << "Profile:: estimated flops per token (including " << transitions_per_token
+    << " transitions/token) = " << total_flops_token + transitions_per_token * total_flops_transition;
+  _INFO << "Profile:: graph nodes per sentence = " << double(n_nodes) / n_sentences
+    << ", per token = " << double(n_nodes) / n_tokens
+    << ", per transition = " << double(n_nodes) / n_transitions;
+}
@@ -0,0 +1,53 @@
+#ifndef MODEL_PROFILER_H
+#define MODEL_PROFILER_H
+
+#include <iostream>
+#include <vector>
+#include "corpus.h"
+#include "dynet/expr.h"
+#include "dynet/model.h"
+#include "dynet/lstm.h"
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+struct ParserStateBuilder;
+
+/// Collect the cost of each component of a parser model. The FLOPs of a
+/// component are estimated as one multiply-add per weight per call, and the
+/// number of calls is given per input token and per transition.
+struct ModelProfiler {
+  struct Component {
+    std::string name;
+    unsigned long n_params;
+    double flops_per_token;
+    double flops_per_transition;
+  };
+
+  std::vector<Component> components;
+  /// average number of characters per word, measured on the data.
+  double chars_per_token;
+
+  ModelProfiler();
+
+  /// Lookup tables cost no FLOPs.
+  void add(const std::string & name, const dynet::LookupParameter & p);
+
+  void add(const std::string & name,
+           const std::vector<dynet::Expression> & params,
+           double calls_per_token,
+           double calls_per_transition);
+
+  void add(const std::string & name,
+           const dynet::CoupledLSTMBuilder & lstm,
+           double calls_per_token,
+           double calls_per_transition);
+};
+
+/// Report the parameters, the estimated FLOPs and the measured graph size
+/// of the model, by greedily parsing the development data.
+void profile_model(const po::variables_map & conf,
+                   Corpus & corpus,
+                   ParserStateBuilder & state_builder);
+
+#endif  //  end for MODEL_PROFILER_H
@@ -10,6 +10,8 @@
 
 namespace po = boost::program_options;
 
+struct ModelProfiler;
+
 struct ParserModel {
   TransitionSystem & system;
 
@@ -22,6 +24,9 @@ struct ParserModel {
   virtual void new_graph(dynet::ComputationGraph& cg) = 0;
 
   virtual std::vector<dynet::Expression> get_params() = 0;
+
+  /// Register the components to the profiler, should be called after new_graph.
+  virtual void profile(ModelProfiler & profiler) = 0;
 };
 
 struct ParserState {
@@ -54,6 +59,16 @@ struct ParserStateBuilder {
                      TransitionSystem & system) : model(model), system(system) {}
 
   virtual ParserState * build() = 0;
+
+  virtual ParserModel & get_parser_model() = 0;
+
+  /// Switch between training and inference. At inference the parameters are
+  /// fixed, so the models can cache what only depends on them.
+  virtual void set_inference_mode(bool inference) {}
+
+  /// Greedily decode without a computation graph, return false if the model
+  /// has no native engine at the moment.
+  virtual bool native_greedy_decode(const InputUnits & input_units, ParseUnits & result) { return false; }
 };
 
 #endif  //  end for PARSER_H
@@ -2,12 +2,16 @@
 #include "dynet/expr.h"
 #include "corpus.h"
 #include "logging.h"
+#include "model_profiler.h"
+#include "lstm_utils.h"
 #include "arceager.h"
 #include "arcstd.h"
 #include "archybrid.h"
 #include "swap.h"
 #include <vector>
 #include <random>
+#include <map>
+#include <algorithm>
 
 void Ballesteros15ParserState::ArcEagerPerformer::perform_action(const unsigned & action,
                                                                  dynet::ComputationGraph & cg) {
@@ -256,6 +260,8 @@ Ballesteros15ParserModel::Ballesteros15ParserModel(dynet::ParameterCollection &
   p_word_start_guard(m.add_parameters({ dim_c })),
   p_word_end_guard(m.add_parameters({ dim_c })),
   p_root_word(m.add_parameters({ dim_w + dim_w })),
+  char_cache(0),
+  inference(false),
   pretrained(pretrained),
   size_c(size_c), dim_c(dim_c), dim_w(dim_w),
   size_p(size_p), dim_p(dim_p),
@@ -313,6 +319,132 @@ std::vector<dynet::Expression> Ballesteros15ParserModel::get_params() {
   return ret;
 }
 
+void Ballesteros15ParserModel::profile(ModelProfiler & profiler) {
+  profiler.add("char_emb", char_emb.p_e);
+  profiler.add("pos_emb", pos_emb.p_e);
+  profiler.add("preword_emb", preword_emb.p_e);
+  profiler.add("act_emb", act_emb.p_e);
+  profiler.add("rel_emb", rel_emb.p_e);
+  // the char lstms run over the characters and the two word guards.
+  profiler.add("fwd_ch_lstm", fwd_ch_lstm, profiler.chars_per_token + 2., 0.);
+  profiler.add("bwd_ch_lstm", bwd_ch_lstm, profiler.chars_per_token + 2., 0.);
+  profiler.add("q_lstm", q_lstm, 1., 0.);
+  profiler.add("s_lstm", s_lstm, 0., 1.);
+  profiler.add("a_lstm", a_lstm, 0., 1.);
+  profiler.add("merge_input", merge_input.get_params(), 1., 0.);
+  profiler.add("merge", merge.get_params(), 0., 1.);
+  profiler.add("composer", composer.get_params(), 0., .5);
+  profiler.add("scorer", scorer.get_params(), 0., 1.);
+  profiler.add("guards", { action_start, buffer_guard, stack_guard,
+                           word_start_guard, word_end_guard, root_word }, 0., 0.);
+}
+
+void Ballesteros15ParserModel::get_char_words(dynet::ComputationGraph & cg,
+                                              const std::vector<std::vector<unsigned>> & words,
+                                              std::vector<dynet::Expression> & word_exprs) {
+  // the words of the same length run through the char LSTMs as one batch, so
+  // that every step of the LSTMs is one batched matrix multiplication.
+  std::map<unsigned, std::vector<unsigned>> groups;
+  for (unsigned i = 0; i < words.size(); ++i) { groups[words[i].size()].push_back(i); }
+
+  word_exprs.resize(words.size());
+  std::vector<unsigned> fwd_ids, bwd_ids;
+  for (auto & payload : groups) {
+    unsigned n_chars = payload.first;
+    const std::vector<unsigned> & group = payload.second;
+    unsigned batch_size = group.size();
+
+    fwd_ch_lstm.start_new_sequence();
+    bwd_ch_lstm.start_new_sequence();
+    dynet::Expression start_guard = word_start_guard, end_guard = word_end_guard;
+    if (batch_size > 1) {
+      start_guard = dynet::concatenate_to_batch(std::vector<dynet::Expression>(batch_size, word_start_guard));
+      end_guard = dynet::concatenate_to_batch(std::vector<dynet::Expression>(batch_size, word_end_guard));
+    }
+    fwd_ch_lstm.add_input(start_guard);
+    bwd_ch_lstm.add_input(end_guard);
+    fwd_ids.resize(batch_size);
+    bwd_ids.resize(batch_size);
+    for (unsigned j = 0; j < n_chars; ++j) {
+      for (unsigned b = 0; b < batch_size; ++b) {
+        fwd_ids[b] = words[group[b]][j];
+        bwd_ids[b] = words[group[b]][n_chars - j - 1];
+      }
+      fwd_ch_lstm.add_input(dynet::lookup(cg, char_emb.p_e, fwd_ids));
+      bwd_ch_lstm.add_input(dynet::lookup(cg, char_emb.p_e, bwd_ids));
+    }
+    fwd_ch_lstm.add_input(end_guard);
+    bwd_ch_lstm.add_input(start_guard);
+    dynet::Expression batch_expr = dynet::concatenate({ fwd_ch_lstm.back(), bwd_ch_lstm.back() });
+    if (batch_size == 1) {
+      word_exprs[group[0]] = batch_expr;
+    } else {
+      for (unsigned b = 0; b < batch_size; ++b) { word_exprs[group[b]] = dynet::pick_batch_elem(batch_expr, b); }
+    }
+  }
+}
+
+void Ballesteros15ParserModel::get_cached_char_words(dynet::ComputationGraph & cg,
+                                                     const std::vector<std::vector<unsigned>> & words,
+                                                     std::vector<dynet::Expression> & word_exprs) {
+  if (!inference || char_cache.capacity == 0) {
+    get_char_words(cg, words, word_exprs);
+    return;
+  }
+
+  // the missed words are encoded in one go, each distinct word only once.
+  word_exprs.resize(words.size());
+  std::vector<std::vector<unsigned>> missed;
+  std::vector<unsigned> missed_index(words.size(), UINT_MAX);
+  std::map<std::vector<unsigned>, unsigned> missed_ids;
+  for (unsigned i = 0; i < words.size(); ++i) {
+    const std::vector<float> * value = char_cache.get(words[i]);
+    if (value != nullptr) {
+      word_exprs[i] = dynet::input(cg, { dim_w + dim_w }, *value);
+      continue;
+    }
+    auto it = missed_ids.find(words[i]);
+    if (it == missed_ids.end()) {
+      it = missed_ids.insert(std::make_pair(words[i], unsigned(missed.size()))).first;
+      missed.push_back(words[i]);
+    }
+    missed_index[i] = it->second;
+  }
+  if (missed.empty()) { return; }
+
+  std::vector<dynet::Expression> missed_exprs;
+  get_char_words(cg, missed, missed_exprs);
+  char_cache.put(cg, missed, missed_exprs);
+  for (unsigned i = 0; i < words.size(); ++i) {
+    if (missed_index[i] != UINT_MAX) { word_exprs[i] = missed_exprs[missed_index[i]]; }
+  }
+}
+
+void Ballesteros15ParserModel::set_inference_mode(bool inference_) {
+  if (inference && !inference_ && char_cache.capacity > 0) {
+    _INFO << "B15:: char cache " << char_cache.entries.size() << " types, hit rate "
+      << char_cache.hit_rate();
+  }
+  char_cache.clear();
+  inference = inference_;
+  if (!inference || char_cache.capacity == 0 || precompute_cids.empty()) { return; }
+
+  // the least frequent first, so the most frequent end up most recently used.
+  const unsigned kBatchSize = 256;
+  unsigned n = std::min<unsigned>(precompute_cids.size(), char_cache.capacity);
+  for (unsigned end = n; end > 0; ) {
+    unsigned start = (end > kBatchSize ? end - kBatchSize : 0);
+    dynet::ComputationGraph cg;
+    new_graph(cg);
+    std::vector<std::vector<unsigned>> words(precompute_cids.rend() - end, precompute_cids.rend() - start);
+    std::vector<dynet::Expression> word_exprs;
+    get_char_words(cg, words, word_exprs);
+    char_cache.put(cg, words, word_exprs);
+    end = start;
+  }
+  _INFO << "B15:: precomputed " << n << " char-LSTM word vectors.";
+}
+
 Ballesteros15ParserState::Ballesteros15ParserState(Ballesteros15ParserModel & model): model(model) {
   std::string system_name = model.system.system_name();
   if (system_name == "arcstd") {
@@ -344,6 +476,12 @@ void Ballesteros15ParserState::initialize(dynet::ComputationGraph & cg,
   stack.clear();
   buffer.resize(len + 1);
 
+  // the char-derived vectors of all the words but ROOT.
+  std::vector<std::vector<unsigned>> words(len - 1);
+  for (unsigned i = 0; i + 1 < len; ++i) { words[i] = input[i].cids; }
+  std::vector<dynet::Expression> word_exprs;
+  model.get_cached_char_words(cg, words, word_exprs);
+
   // Pay attention to this, if the guard word is handled here, there is no need
   // to insert it when loading the data.
   buffer[0] = model.buffer_guard;
@@ -352,31 +490,16 @@ void Ballesteros15ParserState::initialize(dynet::ComputationGraph & cg,
     unsigned nid = input[i].nid;
     if (!model.pretrained.count(nid)) { nid = 0; }
 
-    dynet::Expression word_expr;
-    if (i == len - 1) {
-      // last word, ROOT.
-      word_expr = model.root_word;
-    } else {
-      model.fwd_ch_lstm.start_new_sequence();
-      model.bwd_ch_lstm.start_new_sequence();
-      model.fwd_ch_lstm.add_input(model.word_start_guard);
-      model.bwd_ch_lstm.add_input(model.word_end_guard);
-      unsigned n_chars = input[i].cids.size();
-      for (unsigned j = 0; j < n_chars; ++j) {
-        model.fwd_ch_lstm.add_input(model.char_emb.embed(input[i].cids[j]));
-        model.bwd_ch_lstm.add_input(model.char_emb.embed(input[i].cids[n_chars - j - 1]));
-      }
-      model.fwd_ch_lstm.add_input(model.word_end_guard);
-      model.bwd_ch_lstm.add_input(model.word_start_guard);
-      word_expr = dynet::concatenate({ model.fwd_ch_lstm.back(), model.bwd_ch_lstm.back() });
-    }
+    // last word, ROOT.
+    dynet::Expression word_expr = (i == len - 1 ? model.root_word : word_exprs[i]);
     buffer[len - i] = dynet::rectify(model.merge_input.get_output(
       word_expr, model.pos_emb.embed(pid), model.preword_emb.embed(nid)
     ));
   }
 
   // push word into buffer in reverse order, pay attention to (i == len).
-  for (unsigned i = 0; i <= len; ++i) { model.q_lstm.add_input(buffer[i]); }
+  std::vector<dynet::Expression> q_outputs;
+  add_inputs(model.q_lstm, buffer, q_outputs);
 
   model.s_lstm.add_input(model.stack_guard);
   stack.push_back(model.stack_guard);
@@ -436,6 +559,22 @@ Ballesteros15ParserStateBuilder::Ballesteros15ParserStateBuilder(const po::varia
                                               conf["hidden_dim"].as<unsigned>(),
                                               system,
                                               pretrained);
+  parser_model->char_cache.capacity = conf["char_cache_size"].as<unsigned>();
+  if (conf.count("char_cache_precompute") && parser_model->char_cache.capacity > 0) {
+    std::map<std::vector<unsigned>, unsigned> counts;
+    for (auto & payload : corpus.training_inputs) {
+      const InputUnits & input_units = payload.second;
+      // not counting the dummy root.
+      for (unsigned i = 0; i + 1 < input_units.size(); ++i) { ++counts[input_units[i].cids]; }
+    }
+    std::vector<std::pair<unsigned, std::vector<unsigned>>> types;
+    for (auto & payload : counts) { types.push_back(std::make_pair(payload.second, payload.first)); }
+    std::stable_sort(types.begin(), types.end(),
+                     [](const std::pair<unsigned, std::vector<unsigned>> & a,
+                        const std::pair<unsigned, std::vector<unsigned>> & b) { return a.first > b.first; });
+    for (auto & type : types) { parser_model->precompute_cids.push_back(type.second); }
+    _INFO << "B15:: " << types.size() << " word types to precompute.";
+  }
 }
 
 ParserState * Ballesteros15ParserStateBuilder::build() {
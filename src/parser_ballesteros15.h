@@ -4,6 +4,7 @@
 #include "parser.h"
 #include "corpus.h"
 #include "system.h"
+#include "embedding_cache.h"
 #include "dynet/lstm.h"
 #include "dynet_layer/layer.h"
 #include <vector>
@@ -43,6 +44,13 @@ struct Ballesteros15ParserModel : public ParserModel {
   dynet::Expression word_end_guard;
   dynet::Expression root_word;
   
+  /// The char-derived word vectors keyed by the char ids, only used at inference.
+  EmbeddingCache char_cache;
+  /// The char ids of the training vocabulary to fill the cache with when
+  /// entering inference, the most frequent first. Empty if not precomputed.
+  std::vector<std::vector<unsigned>> precompute_cids;
+  bool inference;
+
   /// The reference
   const Embeddings & pretrained;
 
@@ -71,6 +79,20 @@ struct Ballesteros15ParserModel : public ParserModel {
   void new_graph(dynet::ComputationGraph & cg) override;
 
   std::vector<dynet::Expression> get_params() override;
+
+  void profile(ModelProfiler & profiler) override;
+
+  /// Run the char LSTMs over the words, one expression per word.
+  void get_char_words(dynet::ComputationGraph & cg,
+                      const std::vector<std::vector<unsigned>> & words,
+                      std::vector<dynet::Expression> & word_exprs);
+
+  /// The same as get_char_words, but through the cache at inference.
+  void get_cached_char_words(dynet::ComputationGraph & cg,
+                             const std::vector<std::vector<unsigned>> & words,
+                             std::vector<dynet::Expression> & word_exprs);
+
+  void set_inference_mode(bool inference);
 };
 
 struct Ballesteros15ParserState : public ParserState {
@@ -150,6 +172,10 @@ struct Ballesteros15ParserStateBuilder : public ParserStateBuilder {
                                   const Embeddings & pretrained);
 
   ParserState * build() override;
+
+  ParserModel & get_parser_model() override { return (*parser_model); }
+
+  void set_inference_mode(bool inference) override { parser_model->set_inference_mode(inference); }
 };
 
 #endif  //  end for PARSER_H
@@ -9,7 +9,15 @@ ParserStateBuilder * get_state_builder(const po::variables_map & conf,
                                        TransitionSystem & system,
                                        const Corpus & corpus,
                                        const Embeddings & pretrained) {
-  std::string arch_name = conf["architecture"].as<std::string>();
+  return get_state_builder(conf["architecture"].as<std::string>(), conf, model, system, corpus, pretrained);
+}
+
+ParserStateBuilder * get_state_builder(const std::string & arch_name,
+                                       const po::variables_map & conf,
+                                       dynet::ParameterCollection & model,
+                                       TransitionSystem & system,
+                                       const Corpus & corpus,
+                                       const Embeddings & pretrained) {
   ParserStateBuilder * builder = nullptr;
   if (arch_name == "dyer15" || arch_name == "d15") {
     builder = new Dyer15ParserStateBuilder(conf, model, system, corpus, pretrained);
@@ -15,4 +15,11 @@ ParserStateBuilder * get_state_builder(const po::variables_map & conf,
                                        const Corpus & corpus,
                                        const Embeddings & pretrained);
 
+ParserStateBuilder * get_state_builder(const std::string & arch_name,
+                                       const po::variables_map & conf,
+                                       dynet::ParameterCollection & model,
+                                       TransitionSystem & system,
+                                       const Corpus & corpus,
+                                       const Embeddings & pretrained);
+
 #endif  //  end for PARSER_BUILDER_H
\ No newline at end of file
@@ -2,6 +2,9 @@
 #include "dynet/expr.h"
 #include "corpus.h"
 #include "logging.h"
+#include "model_profiler.h"
+#include "lstm_utils.h"
+#include "parser_dyer15_native.h"
 #include "arceager.h"
 #include "arcstd.h"
 #include "archybrid.h"
@@ -41,6 +44,8 @@ Dyer15ParserModel::Dyer15ParserModel(dynet::ParameterCollection & m,
   p_action_start(m.add_parameters({ dim_a })),
   p_buffer_guard(m.add_parameters({ dim_lstm_in })),
   p_stack_guard(m.add_parameters({ dim_lstm_in })),
+  input_cache(0),
+  inference(false),
   pretrained(pretrained),
   size_w(size_w), dim_w(dim_w),
   size_p(size_p), dim_p(dim_p),
@@ -88,6 +93,24 @@ std::vector<dynet::Expression> Dyer15ParserModel::get_params() {
   return ret;
 }
 
+void Dyer15ParserModel::profile(ModelProfiler & profiler) {
+  profiler.add("word_emb", word_emb.p_e);
+  profiler.add("pos_emb", pos_emb.p_e);
+  profiler.add("preword_emb", preword_emb.p_e);
+  profiler.add("act_emb", act_emb.p_e);
+  profiler.add("rel_emb", rel_emb.p_e);
+  // the buffer is filled once per token, the stack and the action history grow
+  // once per transition and about half of the transitions compose an arc.
+  profiler.add("q_lstm", q_lstm, 1., 0.);
+  profiler.add("s_lstm", s_lstm, 0., 1.);
+  profiler.add("a_lstm", a_lstm, 0., 1.);
+  profiler.add("merge_input", merge_input.get_params(), 1., 0.);
+  profiler.add("merge", merge.get_params(), 0., 1.);
+  profiler.add("composer", composer.get_params(), 0., .5);
+  profiler.add("scorer", scorer.get_params(), 0., 1.);
+  profiler.add("guards", { action_start, buffer_guard, stack_guard }, 0., 0.);
+}
+
 void Dyer15ParserState::ArcEagerPerformer::perform_action(const unsigned & action,
                                                           dynet::ComputationGraph & cg) {
   dynet::Expression act_expr = state->model.act_emb.embed(action);
@@ -297,6 +320,25 @@ void Dyer15ParserState::SwapPerformer::perform_action(const unsigned & action,
   }
 }
 
+void Dyer15ParserModel::get_inputs(dynet::ComputationGraph & cg,
+                                   const InputUnits & input,
+                                   std::vector<dynet::Expression> & inputs) {
+  get_cached_inputs(cg, input_cache, inference, dim_lstm_in, input, &InputUnit::nid, pretrained,
+                    [this](unsigned wid, unsigned pid, unsigned pre_id) -> dynet::Expression {
+                      return dynet::rectify(merge_input.get_output(
+                        word_emb.embed(wid), pos_emb.embed(pid), preword_emb.embed(pre_id)));
+                    }, inputs);
+}
+
+void Dyer15ParserModel::set_inference_mode(bool inference_) {
+  if (inference && !inference_ && input_cache.capacity > 0) {
+    _INFO << "D15:: input cache " << input_cache.entries.size() << " entries, hit rate "
+      << input_cache.hit_rate();
+  }
+  input_cache.clear();
+  inference = inference_;
+}
+
 Dyer15ParserState::Dyer15ParserState(Dyer15ParserModel & model) : model(model) {
   std::string system_name = model.system.system_name();
   if (system_name == "arcstd") {
@@ -331,23 +373,13 @@ void Dyer15ParserState::initialize(dynet::ComputationGraph & cg,
   // Pay attention to this, if the guard word is handled here, there is no need
   // to insert it when loading the data.
   buffer[0] = model.buffer_guard;
-  for (unsigned i = 0; i < len; ++i) {
-    unsigned wid = input[i].wid;
-    unsigned pid = input[i].pid;
-    unsigned nid = input[i].nid;
-    if (!model.pretrained.count(nid)) { nid = 0; }
-
-    buffer[len - i] = dynet::rectify(model.merge_input.get_output(
-      model.word_emb.embed(wid),
-      model.pos_emb.embed(pid),
-      model.preword_emb.embed(nid)
-    ));
-  }
+  std::vector<dynet::Expression> inputs;
+  model.get_inputs(cg, input, inputs);
+  for (unsigned i = 0; i < len; ++i) { buffer[len - i] = inputs[i]; }
 
   // push word into buffer in reverse order, pay attention to (i == len).
-  for (unsigned i = 0; i <= len; ++i) {
-    model.q_lstm.add_input(buffer[i]);
-  }
+  std::vector<dynet::Expression> q_outputs;
+  add_inputs(model.q_lstm, buffer, q_outputs);
 
   model.s_lstm.add_input(model.stack_guard);
   stack.push_back(model.stack_guard);
@@ -389,7 +421,7 @@ Dyer15ParserStateBuilder::Dyer15ParserStateBuilder(const po::variables_map & con
                                                    TransitionSystem & system,
                                                    const Corpus & corpus,
                                                    const Embeddings & pretrained) :
-  ParserStateBuilder(model, system) {
+  ParserStateBuilder(model, system), native_engine(nullptr), use_native(conf.count("native_inference") > 0) {
   parser_model = new Dyer15ParserModel(model,
                                        corpus.training_vocab.size() + 10,
                                        conf["word_dim"].as<unsigned>(),
@@ -406,8 +438,27 @@ Dyer15ParserStateBuilder::Dyer15ParserStateBuilder(const po::variables_map & con
                                        conf["hidden_dim"].as<unsigned>(),
                                        system,
                                        pretrained);
+  parser_model->input_cache.capacity = conf["input_cache_size"].as<unsigned>();
 }
 
 ParserState * Dyer15ParserStateBuilder::build() {
   return new Dyer15ParserState(*parser_model);
 }
+
+void Dyer15ParserStateBuilder::set_inference_mode(bool inference) {
+  parser_model->set_inference_mode(inference);
+  if (!use_native) { return; }
+  if (native_engine == nullptr) { native_engine = new Dyer15NativeEngine(*parser_model); }
+  // the weights are read again every time, they may have been updated in between.
+  if (!inference) {
+    native_engine->loaded = false;
+  } else if (!native_engine->load()) {
+    _WARN << "D15:: native engine disagrees with the model, fall back to dynet.";
+  }
+}
+
+bool Dyer15ParserStateBuilder::native_greedy_decode(const InputUnits & input_units, ParseUnits & result) {
+  if (native_engine == nullptr || !native_engine->loaded) { return false; }
+  native_engine->decode(input_units, result);
+  return true;
+}
@@ -4,6 +4,7 @@
 #include "parser.h"
 #include "corpus.h"
 #include "system.h"
+#include "embedding_cache.h"
 #include "dynet/lstm.h"
 #include "dynet_layer/layer.h"
 #include <vector>
@@ -35,6 +36,10 @@ struct Dyer15ParserModel : public ParserModel {
   dynet::Expression buffer_guard;
   dynet::Expression stack_guard;
 
+  /// The merged input vectors keyed by (word, pos, pretrained), only used at inference.
+  EmbeddingCache input_cache;
+  bool inference;
+
   const Embeddings & pretrained;
 
   /// The Configurations: useful for other models.
@@ -61,6 +66,15 @@ struct Dyer15ParserModel : public ParserModel {
   void new_graph(dynet::ComputationGraph & cg) override;
 
   std::vector<dynet::Expression> get_params() override;
+
+  void profile(ModelProfiler & profiler) override;
+
+  /// Get the merged input vector of each word, through the cache at inference.
+  void get_inputs(dynet::ComputationGraph & cg,
+                  const InputUnits & input,
+                  std::vector<dynet::Expression> & inputs);
+
+  void set_inference_mode(bool inference);
 };
 
 struct Dyer15ParserState : public ParserState {
@@ -130,8 +144,13 @@ struct Dyer15ParserState : public ParserState {
   std::vector<dynet::Expression> get_params() override;
 };
 
+struct Dyer15NativeEngine;
+
 struct Dyer15ParserStateBuilder : public ParserStateBuilder {
   Dyer15ParserModel * parser_model;
+  /// The graph-free greedy decoder, only loaded at inference.
+  Dyer15NativeEngine * native_engine;
+  bool use_native;
 
   Dyer15ParserStateBuilder(const po::variables_map & conf,
                            dynet::ParameterCollection & model,
@@ -140,6 +159,12 @@ struct Dyer15ParserStateBuilder : public ParserStateBuilder {
                            const Embeddings & pretrained);
 
   ParserState * build() override;
+
+  ParserModel & get_parser_model() override { return (*parser_model); }
+
+  void set_inference_mode(bool inference) override;
+
+  bool native_greedy_decode(const InputUnits & input_units, ParseUnits & result) override;
 };
 
 #endif  //  end for PARSER_H
@@ -0,0 +1,383 @@
+#include "parser_dyer15_native.h"
+#include "dynet/expr.h"
+#include "logging.h"
+#include "arceager.h"
+#include "arcstd.h"
+#include "archybrid.h"
+#include "swap.h"
+#include <cmath>
+#include <random>
+#include <climits>
+
+typedef Dyer15NativeEngine::Vector Vector;
+typedef Dyer15NativeEngine::Matrix Matrix;
+typedef Dyer15NativeEngine::VectorRef VectorRef;
+
+// the order of the parameters of each layer in CoupledLSTMBuilder::params.
+enum { X2I, H2I, C2I, BI, X2O, H2O, C2O, BO, X2C, H2C, BC };
+
+static Matrix to_matrix(const dynet::Tensor & t) {
+  return Eigen::Map<const Matrix>(t.v, t.d.rows(), t.d.cols());
+}
+
+static Eigen::Map<const Vector> lookup(const dynet::LookupParameter & p, unsigned id) {
+  const dynet::Tensor & t = p.get_storage().values[id];
+  return Eigen::Map<const Vector>(t.v, t.d.size());
+}
+
+/* The bias is the only parameter with one column, the weights follow the
+ * order of the inputs. The order is checked against dynet in check(). */
+static bool load_affine(dynet::ComputationGraph & cg,
+                        const std::vector<dynet::Expression> & params,
+                        unsigned n_inputs,
+                        Dyer15NativeEngine::Affine & layer) {
+  bool has_bias = false;
+  layer.W.clear();
+  for (const dynet::Expression & e : params) {
+    Matrix value = to_matrix(cg.get_value(e));
+    if (value.cols() == 1 && !has_bias) {
+      layer.b = value.col(0);
+      has_bias = true;
+    } else {
+      layer.W.push_back(value);
+    }
+  }
+  return (has_bias && layer.W.size() == n_inputs);
+}
+
+static void load_lstm(const dynet::CoupledLSTMBuilder & lstm, Dyer15NativeEngine::LSTM & native) {
+  native = Dyer15NativeEngine::LSTM();
+  for (const std::vector<dynet::Parameter> & params : lstm.params) {
+    native.x2i.push_back(to_matrix(params[X2I].get_storage().values));
+    native.h2i.push_back(to_matrix(params[H2I].get_storage().values));
+    native.c2i.push_back(to_matrix(params[C2I].get_storage().values));
+    native.x2o.push_back(to_matrix(params[X2O].get_storage().values));
+    native.h2o.push_back(to_matrix(params[H2O].get_storage().values));
+    native.c2o.push_back(to_matrix(params[C2O].get_storage().values));
+    native.x2c.push_back(to_matrix(params[X2C].get_storage().values));
+    native.h2c.push_back(to_matrix(params[H2C].get_storage().values));
+    native.bi.push_back(to_matrix(params[BI].get_storage().values).col(0));
+    native.bo.push_back(to_matrix(params[BO].get_storage().values).col(0));
+    native.bc.push_back(to_matrix(params[BC].get_storage().values).col(0));
+  }
+}
+
+static void affine(const Dyer15NativeEngine::Affine & layer, const VectorRef & x0, Vector & out) {
+  out = layer.b;
+  out.noalias() += layer.W[0] * x0;
+}
+
+static void affine(const Dyer15NativeEngine::Affine & layer,
+                   const VectorRef & x0, const VectorRef & x1, const VectorRef & x2,
+                   Vector & out) {
+  out = layer.b;
+  out.noalias() += layer.W[0] * x0;
+  out.noalias() += layer.W[1] * x1;
+  out.noalias() += layer.W[2] * x2;
+}
+
+static void rectify_inplace(Vector & x) { x = x.cwiseMax(0.f); }
+
+static void logistic_inplace(Vector & x) { x = (1.f + (-x.array()).exp()).inverse().matrix(); }
+
+static void tanh_inplace(Vector & x) { x = x.array().tanh().matrix(); }
+
+Dyer15NativeEngine::Dyer15NativeEngine(Dyer15ParserModel & model) :
+  model(model), system_name(model.system.system_name()), loaded(false), n_nodes(0) {
+  s_states.size = 0;
+  q_states.size = 0;
+}
+
+bool Dyer15NativeEngine::load() {
+  loaded = false;
+  dynet::ComputationGraph cg;
+  model.new_graph(cg);
+  if (!load_affine(cg, model.merge_input.get_params(), 3, merge_input) ||
+      !load_affine(cg, model.merge.get_params(), 3, merge) ||
+      !load_affine(cg, model.composer.get_params(), 3, composer) ||
+      !load_affine(cg, model.scorer.get_params(), 1, scorer)) {
+    _WARN << "D15Native:: unexpected layer parameters.";
+    return false;
+  }
+  load_lstm(model.s_lstm, s_lstm);
+  load_lstm(model.q_lstm, q_lstm);
+  load_lstm(model.a_lstm, a_lstm);
+  action_start = to_matrix(model.p_action_start.get_storage().values).col(0);
+  buffer_guard = to_matrix(model.p_buffer_guard.get_storage().values).col(0);
+  stack_guard = to_matrix(model.p_stack_guard.get_storage().values).col(0);
+  loaded = check(cg);
+  return loaded;
+}
+
+void Dyer15NativeEngine::step(const LSTM & lstm, const LSTMState * prev, const VectorRef & x, LSTMState & out) {
+  unsigned n_layers = lstm.x2i.size();
+  out.c.resize(n_layers);
+  out.h.resize(n_layers);
+  for (unsigned l = 0; l < n_layers; ++l) {
+    const VectorRef in = (l == 0 ? x : VectorRef(out.h[l - 1]));
+    i_t = lstm.bi[l];
+    i_t.noalias() += lstm.x2i[l] * in;
+    w_t = lstm.bc[l];
+    w_t.noalias() += lstm.x2c[l] * in;
+    o_t = lstm.bo[l];
+    o_t.noalias() += lstm.x2o[l] * in;
+    if (prev != nullptr) {
+      i_t.noalias() += lstm.h2i[l] * prev->h[l];
+      i_t.noalias() += lstm.c2i[l] * prev->c[l];
+      w_t.noalias() += lstm.h2c[l] * prev->h[l];
+      o_t.noalias() += lstm.h2o[l] * prev->h[l];
+    }
+    logistic_inplace(i_t);
+    tanh_inplace(w_t);
+    if (prev != nullptr) {
+      out.c[l] = (1.f - i_t.array()) * prev->c[l].array() + i_t.array() * w_t.array();
+    } else {
+      out.c[l] = i_t.cwiseProduct(w_t);
+    }
+    o_t.noalias() += lstm.c2o[l] * out.c[l];
+    logistic_inplace(o_t);
+    out.h[l] = o_t.array() * out.c[l].array().tanh();
+  }
+}
+
+void Dyer15NativeEngine::push(LSTMStack & states, const LSTM & lstm, const Vector & x) {
+  if (states.size == states.states.size()) { states.states.emplace_back(); }
+  const LSTMState * prev = (states.size > 0 ? &states.states[states.size - 1] : nullptr);
+  step(lstm, prev, x, states.states[states.size]);
+  ++states.size;
+}
+
+unsigned Dyer15NativeEngine::new_node() {
+  if (n_nodes == nodes.size()) { nodes.emplace_back(); }
+  return n_nodes++;
+}
+
+void Dyer15NativeEngine::embed_input(const InputUnit & u, Vector & out) {
+  unsigned nid = u.nid;
+  if (!model.pretrained.count(nid)) { nid = 0; }
+  affine(merge_input,
+         lookup(model.word_emb.p_e, u.wid),
+         lookup(model.pos_emb.p_e, u.pid),
+         lookup(model.preword_emb.p_e, nid),
+         out);
+  rectify_inplace(out);
+}
+
+void Dyer15NativeEngine::compose(const Vector & hed, const Vector & mod, unsigned rel, Vector & out) {
+  affine(composer, hed, mod, lookup(model.rel_emb.p_e, rel), out);
+  tanh_inplace(out);
+}
+
+void Dyer15NativeEngine::decode(const InputUnits & input_units, ParseUnits & result) {
+  TransitionSystem & system = model.system;
+  unsigned len = input_units.size();
+  n_nodes = 0;
+  s_states.size = 0;
+  q_states.size = 0;
+
+  // the same layout as Dyer15ParserState::initialize, the front of the buffer at the back.
+  buffer.resize(len + 1);
+  buffer[0] = new_node();
+  nodes[buffer[0]] = buffer_guard;
+  for (unsigned i = 0; i < len; ++i) {
+    buffer[len - i] = new_node();
+    embed_input(input_units[i], nodes[buffer[len - i]]);
+  }
+  for (unsigned i = 0; i <= len; ++i) { push(q_states, q_lstm, nodes[buffer[i]]); }
+
+  stack.clear();
+  stack.push_back(new_node());
+  nodes[stack.back()] = stack_guard;
+  push(s_states, s_lstm, stack_guard);
+  step(a_lstm, nullptr, action_start, a_state);
+
+  TransitionState transition_state(len);
+  transition_state.initialize(input_units);
+  std::vector<unsigned> valid_actions;
+  std::vector<float> scores;
+  while (!transition_state.terminated()) {
+    system.get_decoding_actions(transition_state, input_units, valid_actions);
+    if (valid_actions.size() == 1) {
+      system.perform_action(transition_state, valid_actions[0]);
+      perform_action(valid_actions[0]);
+      continue;
+    }
+
+    affine(merge,
+           s_states.states[s_states.size - 1].h.back(),
+           q_states.states[q_states.size - 1].h.back(),
+           a_state.h.back(),
+           hidden);
+    rectify_inplace(hidden);
+    if (valid_actions.size() * 2 < unsigned(scorer.b.size())) {
+      // only the rows of the valid actions, e.g. after the labels are pruned.
+      scores.resize(scorer.b.size());
+      for (unsigned a : valid_actions) { scores[a] = scorer.b(a) + scorer.W[0].row(a).dot(hidden); }
+    } else {
+      affine(scorer, hidden, score);
+      scores.assign(score.data(), score.data() + score.size());
+    }
+
+    unsigned best_a = ParserState::get_best_action(scores, valid_actions).first;
+    system.perform_action(transition_state, best_a);
+    perform_action(best_a);
+  }
+  vector_to_parse(transition_state.heads, transition_state.deprels, result);
+}
+
+/* Mirror the action performers of Dyer15ParserState on the native states. */
+void Dyer15NativeEngine::perform_action(unsigned action) {
+  step(a_lstm, &a_state, lookup(model.act_emb.p_e, action), a_next);
+  std::swap(a_state, a_next);
+  unsigned _, deprel; model.system.split(action, _, deprel);
+  unsigned rel = (deprel == UINT_MAX ? model.size_l : deprel);
+
+  bool shift = false, swap = false, reduce = false, buffer_head = false, right_eager = false;
+  if (system_name == "arceager") {
+    shift = ArcEager::is_shift(action);
+    reduce = ArcEager::is_reduce(action);
+    buffer_head = ArcEager::is_left(action);
+    right_eager = ArcEager::is_right(action);
+  } else if (system_name == "arcstd") {
+    shift = ArcStandard::is_shift(action);
+  } else if (system_name == "archybrid") {
+    shift = ArcHybrid::is_shift(action);
+    buffer_head = ArcHybrid::is_left(action);
+  } else {
+    shift = Swap::is_shift(action);
+    swap = Swap::is_swap(action);
+  }
+
+  if (shift) {
+    stack.push_back(buffer.back());
+    push(s_states, s_lstm, nodes[stack.back()]);
+    buffer.pop_back();
+    --q_states.size;
+  } else if (reduce) {
+    stack.pop_back();
+    --s_states.size;
+  } else if (swap) {
+    unsigned j = stack.back();
+    unsigned i = stack[stack.size() - 2];
+    stack.pop_back(); stack.pop_back();
+    s_states.size -= 2;
+    stack.push_back(j);
+    push(s_states, s_lstm, nodes[j]);
+    buffer.push_back(i);
+    push(q_states, q_lstm, nodes[i]);
+  } else if (buffer_head) {
+    // the left arc of arceager and archybrid: the buffer front heads the stack top.
+    unsigned hed = buffer.back();
+    unsigned mod = stack.back();
+    stack.pop_back();
+    buffer.pop_back();
+    --s_states.size;
+    --q_states.size;
+    unsigned c = new_node();
+    compose(nodes[hed], nodes[mod], rel, nodes[c]);
+    buffer.push_back(c);
+    push(q_states, q_lstm, nodes[c]);
+  } else if (right_eager) {
+    unsigned mod = buffer.back();
+    unsigned hed = stack.back();
+    stack.pop_back();
+    --s_states.size;
+    unsigned c = new_node();
+    compose(nodes[hed], nodes[mod], rel, nodes[c]);
+    stack.push_back(c);
+    push(s_states, s_lstm, nodes[c]);
+    stack.push_back(mod);
+    push(s_states, s_lstm, nodes[mod]);
+    buffer.pop_back();
+    --q_states.size;
+  } else {
+    // the arcs between the two stack tops.
+    bool left;
+    if (system_name == "arcstd") {
+      left = ArcStandard::is_left(action);
+    } else if (system_name == "archybrid") {
+      left = false;
+    } else {
+      left = Swap::is_left(action);
+    }
+    unsigned top = stack.back();
+    unsigned second = stack[stack.size() - 2];
+    unsigned hed = (left ? top : second);
+    unsigned mod = (left ? second : top);
+    stack.pop_back(); stack.pop_back();
+    s_states.size -= 2;
+    unsigned c = new_node();
+    compose(nodes[hed], nodes[mod], rel, nodes[c]);
+    stack.push_back(c);
+    push(s_states, s_lstm, nodes[c]);
+  }
+}
+
+/* Run every kernel once on the same input as the dynet model. */
+bool Dyer15NativeEngine::check(dynet::ComputationGraph & cg) {
+  std::mt19937 gen(1);
+  std::normal_distribution<float> distribution(0.f, 1.f);
+  auto random_input = [&](unsigned dim, Vector & native) -> dynet::Expression {
+    std::vector<float> values(dim);
+    for (float & v : values) { v = distribution(gen); }
+    native = Eigen::Map<const Vector>(values.data(), dim);
+    return dynet::input(cg, { dim }, values);
+  };
+  auto agree = [&](const std::string & name, const dynet::Expression & expr, const Vector & native) -> bool {
+    std::vector<float> values = dynet::as_vector(cg.incremental_forward(expr));
+    if (values.size() != unsigned(native.size())) {
+      _WARN << "D15Native:: " << name << " has " << native.size() << " dimensions, "
+        << values.size() << " in dynet.";
+      return false;
+    }
+    float diff = 0.f, norm = 0.f;
+    for (unsigned i = 0; i < values.size(); ++i) {
+      diff = std::max(diff, std::fabs(values[i] - native(i)));
+      norm = std::max(norm, std::fabs(values[i]));
+    }
+    if (diff > 1e-4f * (1.f + norm)) {
+      _WARN << "D15Native:: " << name << " differs from dynet by " << diff;
+      return false;
+    }
+    return true;
+  };
+
+  Vector x0, x1, x2, native;
+  InputUnit u;
+  u.wid = 1; u.pid = 1; u.nid = 0;
+  embed_input(u, native);
+  if (!agree("merge_input", dynet::rectify(model.merge_input.get_output(
+    model.word_emb.embed(1), model.pos_emb.embed(1), model.preword_emb.embed(0))), native)) { return false; }
+
+  dynet::Expression e0 = random_input(model.dim_hidden, x0);
+  dynet::Expression e1 = random_input(model.dim_hidden, x1);
+  dynet::Expression e2 = random_input(model.dim_hidden, x2);
+  affine(merge, x0, x1, x2, native);
+  if (!agree("merge", model.merge.get_output(e0, e1, e2), native)) { return false; }
+  affine(scorer, x0, native);
+  if (!agree("scorer", model.scorer.get_output(e0), native)) { return false; }
+
+  e0 = random_input(model.dim_lstm_in, x0);
+  e1 = random_input(model.dim_lstm_in, x1);
+  compose(x0, x1, 0, native);
+  if (!agree("composer", dynet::tanh(model.composer.get_output(e0, e1, model.rel_emb.embed(0))), native)) {
+    return false;
+  }
+
+  std::vector<std::pair<dynet::CoupledLSTMBuilder *, LSTM *>> lstms = {
+    { &model.s_lstm, &s_lstm }, { &model.q_lstm, &q_lstm }, { &model.a_lstm, &a_lstm }
+  };
+  for (auto & payload : lstms) {
+    unsigned dim_input = payload.second->x2i[0].cols();
+    e0 = random_input(dim_input, x0);
+    e1 = random_input(dim_input, x1);
+    payload.first->start_new_sequence();
+    payload.first->add_input(e0);
+    dynet::Expression h = payload.first->add_input(e1);
+    LSTMState first, second;
+    step(*payload.second, nullptr, x0, first);
+    step(*payload.second, &first, x1, second);
+    if (!agree("lstm", h, second.h.back())) { return false; }
+  }
+  return true;
+}
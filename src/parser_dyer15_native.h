@@ -0,0 +1,83 @@
+#ifndef PARSER_DYER15_NATIVE_H
+#define PARSER_DYER15_NATIVE_H
+
+#include "parser_dyer15.h"
+#include "corpus.h"
+#include <vector>
+#include <Eigen/Dense>
+
+/// An inference-only greedy decoder for Dyer15ParserModel. The weights are read
+/// once out of the dynet model, and the stack, buffer and action LSTMs run as
+/// plain Eigen kernels over states that are reused across sentences, so no
+/// computation graph is built while decoding. Only valid while the parameters
+/// are fixed.
+struct Dyer15NativeEngine {
+  typedef Eigen::MatrixXf Matrix;
+  typedef Eigen::VectorXf Vector;
+  typedef Eigen::Ref<const Vector> VectorRef;
+
+  /// b + W[0] * x0 + W[1] * x1 + ...
+  struct Affine {
+    Vector b;
+    std::vector<Matrix> W;
+  };
+
+  /// The weights of a CoupledLSTMBuilder, one entry per layer.
+  struct LSTM {
+    std::vector<Matrix> x2i, h2i, c2i, x2o, h2o, c2o, x2c, h2c;
+    std::vector<Vector> bi, bo, bc;
+  };
+
+  /// The cells and the outputs of all the layers after one step.
+  struct LSTMState {
+    std::vector<Vector> c;
+    std::vector<Vector> h;
+  };
+
+  /// The states of a stack LSTM on the current path, only the first size are valid.
+  struct LSTMStack {
+    std::vector<LSTMState> states;
+    unsigned size;
+  };
+
+  Dyer15ParserModel & model;
+  std::string system_name;
+  bool loaded;
+
+  Affine merge_input, merge, composer, scorer;
+  LSTM s_lstm, q_lstm, a_lstm;
+  Vector action_start, buffer_guard, stack_guard;
+
+  LSTMStack s_states, q_states;
+  LSTMState a_state, a_next;
+  /// the input and composed vectors of the sentence, stack and buffer index them.
+  std::vector<Vector> nodes;
+  unsigned n_nodes;
+  std::vector<unsigned> stack, buffer;
+  Vector i_t, w_t, o_t, hidden, score;
+
+  explicit Dyer15NativeEngine(Dyer15ParserModel & model);
+
+  /// Read the weights and check the kernels against the dynet model, return
+  /// false if they disagree.
+  bool load();
+
+  void decode(const InputUnits & input_units, ParseUnits & result);
+
+private:
+  void step(const LSTM & lstm, const LSTMState * prev, const VectorRef & x, LSTMState & out);
+
+  void push(LSTMStack & states, const LSTM & lstm, const Vector & x);
+
+  unsigned new_node();
+
+  void embed_input(const InputUnit & u, Vector & out);
+
+  void compose(const Vector & hed, const Vector & mod, unsigned rel, Vector & out);
+
+  void perform_action(unsigned action);
+
+  bool check(dynet::ComputationGraph & cg);
+};
+
+#endif  //  end for PARSER_DYER15_NATIVE_H
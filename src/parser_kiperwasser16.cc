@@ -1,5 +1,7 @@
 #include "parser_kiperwasser16.h"
 #include "logging.h"
+#include "model_profiler.h"
+#include "lstm_utils.h"
 
 Kiperwasser16ParserModel::Kiperwasser16ParserModel(dynet::ParameterCollection & m,
                                                    unsigned size_w,
@@ -26,6 +28,8 @@ Kiperwasser16ParserModel::Kiperwasser16ParserModel(dynet::ParameterCollection &
   p_empty(m.add_parameters({ dim_hidden })),
   p_fwd_guard(m.add_parameters({ dim_lstm_in })),
   p_bwd_guard(m.add_parameters({ dim_lstm_in })),
+  input_cache(0),
+  inference(false),
   pretrained(pretrained),
   size_w(size_w), dim_w(dim_w),
   size_p(size_p), dim_p(dim_p),
@@ -65,6 +69,18 @@ std::vector<dynet::Expression> Kiperwasser16ParserModel::get_params() {
   return ret;
 }
 
+void Kiperwasser16ParserModel::profile(ModelProfiler & profiler) {
+  profiler.add("word_emb", word_emb.p_e);
+  profiler.add("pos_emb", pos_emb.p_e);
+  profiler.add("preword_emb", preword_emb.p_e);
+  profiler.add("fwd_lstm", fwd_lstm, 1., 0.);
+  profiler.add("bwd_lstm", bwd_lstm, 1., 0.);
+  profiler.add("merge_input", merge_input.get_params(), 1., 0.);
+  profiler.add("merge", merge.get_params(), 0., 1.);
+  profiler.add("scorer", scorer.get_params(), 0., 1.);
+  profiler.add("guards", { empty, fwd_guard, bwd_guard }, 0., 0.);
+}
+
 void Kiperwasser16ParserState::ArcEagerExtractor::extract(const TransitionState & state) {
   dynet::Expression & empty = hook->model.empty;
   dynet::Expression & f0 = hook->f0;
@@ -133,6 +149,25 @@ void Kiperwasser16ParserState::SwapExtractor::extract(const TransitionState & st
   f3 = (buffer_size > 1 ? encoded[state.buffer[buffer_size - 1]] : empty);
 }
 
+void Kiperwasser16ParserModel::get_inputs(dynet::ComputationGraph & cg,
+                                          const InputUnits & input,
+                                          std::vector<dynet::Expression> & inputs) {
+  get_cached_inputs(cg, input_cache, inference, dim_lstm_in, input, &InputUnit::aux_wid, pretrained,
+                    [this](unsigned wid, unsigned pid, unsigned pre_id) -> dynet::Expression {
+                      return dynet::rectify(merge_input.get_output(
+                        word_emb.embed(wid), pos_emb.embed(pid), preword_emb.embed(pre_id)));
+                    }, inputs);
+}
+
+void Kiperwasser16ParserModel::set_inference_mode(bool inference_) {
+  if (inference && !inference_ && input_cache.capacity > 0) {
+    _INFO << "K16:: input cache " << input_cache.entries.size() << " entries, hit rate "
+      << input_cache.hit_rate();
+  }
+  input_cache.clear();
+  inference = inference_;
+}
+
 Kiperwasser16ParserState::Kiperwasser16ParserState(Kiperwasser16ParserModel & model) : model(model) {
   std::string system_name = model.system.system_name();
   if (system_name == "arcstd") {
@@ -159,33 +194,23 @@ void Kiperwasser16ParserState::initialize(dynet::ComputationGraph & cg,
   model.bwd_lstm.start_new_sequence();
 
   unsigned len = input.size();
-  std::vector<dynet::Expression> lstm_input(len);
-  for (unsigned i = 0; i < len; ++i) {
-    unsigned wid = input[i].wid;
-    unsigned pid = input[i].pid;
-    unsigned aux_wid = input[i].aux_wid;
-    if (!model.pretrained.count(aux_wid)) { aux_wid = 0; }
-
-    lstm_input[i] = dynet::rectify(model.merge_input.get_output(
-      model.word_emb.embed(wid),
-      model.pos_emb.embed(pid), 
-      model.preword_emb.embed(aux_wid))
-    );
-  }
+  std::vector<dynet::Expression> lstm_input;
+  model.get_inputs(cg, input, lstm_input);
 
-  model.fwd_lstm.add_input(model.fwd_guard);
-  model.bwd_lstm.add_input(model.bwd_guard);
-  std::vector<dynet::Expression> fwd_lstm_output(len);
-  std::vector<dynet::Expression> bwd_lstm_output(len);
+  // the guard goes first in both directions.
+  std::vector<dynet::Expression> fwd_lstm_input(len + 1), bwd_lstm_input(len + 1);
+  fwd_lstm_input[0] = model.fwd_guard;
+  bwd_lstm_input[0] = model.bwd_guard;
   for (unsigned i = 0; i < len; ++i) {
-    model.fwd_lstm.add_input(lstm_input[i]);
-    model.bwd_lstm.add_input(lstm_input[len - 1 - i]);
-    fwd_lstm_output[i] = model.fwd_lstm.back();
-    bwd_lstm_output[len - 1 - i] = model.bwd_lstm.back();
+    fwd_lstm_input[i + 1] = lstm_input[i];
+    bwd_lstm_input[i + 1] = lstm_input[len - 1 - i];
   }
+  std::vector<dynet::Expression> fwd_lstm_output, bwd_lstm_output;
+  add_inputs(model.fwd_lstm, fwd_lstm_input, fwd_lstm_output);
+  add_inputs(model.bwd_lstm, bwd_lstm_input, bwd_lstm_output);
   encoded.resize(len);
   for (unsigned i = 0; i < len; ++i) {
-    encoded[i] = dynet::concatenate({ fwd_lstm_output[i], bwd_lstm_output[i] });
+    encoded[i] = dynet::concatenate({ fwd_lstm_output[i + 1], bwd_lstm_output[len - i] });
   }
 
   TransitionState state(len);
@@ -237,6 +262,7 @@ Kiperwasser16ParserStateBuilder::Kiperwasser16ParserStateBuilder(const po::varia
                                               conf["hidden_dim"].as<unsigned>(),
                                               system,
                                               pretrained);
+  parser_model->input_cache.capacity = conf["input_cache_size"].as<unsigned>();
 }
 
 ParserState * Kiperwasser16ParserStateBuilder::build() {
@@ -4,6 +4,7 @@
 #include "parser.h"
 #include "corpus.h"
 #include "system.h"
+#include "embedding_cache.h"
 #include "dynet/lstm.h"
 #include "dynet_layer/layer.h"
 #include <vector>
@@ -27,6 +28,10 @@ struct Kiperwasser16ParserModel : public ParserModel {
   dynet::Expression fwd_guard;
   dynet::Expression bwd_guard;
 
+  /// The merged input vectors keyed by (word, pos, pretrained), only used at inference.
+  EmbeddingCache input_cache;
+  bool inference;
+
   const Embeddings & pretrained;
 
   unsigned size_w, dim_w, size_p, dim_p, size_t, dim_t, size_a;
@@ -49,6 +54,15 @@ struct Kiperwasser16ParserModel : public ParserModel {
   void new_graph(dynet::ComputationGraph & cg) override;
 
   std::vector<dynet::Expression> get_params() override;
+
+  void profile(ModelProfiler & profiler) override;
+
+  /// Get the merged input vector of each word, through the cache at inference.
+  void get_inputs(dynet::ComputationGraph & cg,
+                  const InputUnits & input,
+                  std::vector<dynet::Expression> & inputs);
+
+  void set_inference_mode(bool inference);
 };
 
 struct Kiperwasser16ParserState : public ParserState {
@@ -124,6 +138,10 @@ struct Kiperwasser16ParserStateBuilder : public ParserStateBuilder {
                                   const Embeddings & pretrained);
 
   ParserState * build() override;
+
+  ParserModel & get_parser_model() override { return (*parser_model); }
+
+  void set_inference_mode(bool inference) override { parser_model->set_inference_mode(inference); }
 };
 
 
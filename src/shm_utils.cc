@@ -0,0 +1,105 @@
+#include "shm_utils.h"
+#include "logging.h"
+#include <cstdlib>
+#include <cstring>
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#endif
+
+void * shm_alloc(size_t size) {
+#ifndef _MSC_VER
+  void * ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  return (ptr == MAP_FAILED ? nullptr : ptr);
+#else
+  return nullptr;
+#endif
+}
+
+void shm_free(void * ptr, size_t size) {
+#ifndef _MSC_VER
+  if (ptr != nullptr) { munmap(ptr, size); }
+#endif
+}
+
+// keep every parameter 32-byte aligned, as dynet does in its own pool.
+static size_t aligned_size(size_t n) {
+  return (n + 7) / 8 * 8;
+}
+
+// copy the values of all the parameters to dst and point them there, return
+// the number of floats needed. With dst = nullptr, only the size is returned.
+static size_t relocate_parameters(dynet::ParameterCollection & model, float * dst) {
+  size_t n = 0;
+  for (auto & p : model.parameters_list()) {
+    size_t size = p->values.d.size();
+    if (dst != nullptr) {
+      std::memcpy(dst + n, p->values.v, size * sizeof(float));
+      p->values.v = dst + n;
+    }
+    n += aligned_size(size);
+  }
+  for (auto & p : model.lookup_parameters_list()) {
+    size_t size = p->all_values.d.size();
+    if (dst != nullptr) {
+      std::memcpy(dst + n, p->all_values.v, size * sizeof(float));
+      for (auto & v : p->values) { v.v = dst + n + (v.v - p->all_values.v); }
+      p->all_values.v = dst + n;
+    }
+    n += aligned_size(size);
+  }
+  return n;
+}
+
+void * share_parameters(dynet::ParameterCollection & model, size_t & size) {
+#ifndef _MSC_VER
+  size = relocate_parameters(model, nullptr) * sizeof(float);
+  float * shm = static_cast<float *>(shm_alloc(size));
+  if (shm == nullptr) {
+    _ERROR << "SHM:: failed to allocate " << size << " bytes.";
+    return nullptr;
+  }
+  relocate_parameters(model, shm);
+  _INFO << "SHM:: " << size << " bytes of parameters moved to shared memory.";
+  return shm;
+#else
+  return nullptr;
+#endif
+}
+
+bool unshare_parameters(dynet::ParameterCollection & model) {
+#ifndef _MSC_VER
+  size_t size = relocate_parameters(model, nullptr) * sizeof(float);
+  // never freed, the private copy holds the values for the rest of the process.
+  void * mem = nullptr;
+  if (posix_memalign(&mem, 32, size) != 0) {
+    _ERROR << "SHM:: failed to allocate " << size << " bytes.";
+    return false;
+  }
+  relocate_parameters(model, static_cast<float *>(mem));
+  return true;
+#else
+  return false;
+#endif
+}
+
+void ProcessBarrier::init(unsigned n) {
+#ifndef _MSC_VER
+  pthread_barrierattr_t attr;
+  pthread_barrierattr_init(&attr);
+  pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_barrier_init(&barrier, &attr, n);
+  pthread_barrierattr_destroy(&attr);
+#endif
+}
+
+void ProcessBarrier::wait() {
+#ifndef _MSC_VER
+  pthread_barrier_wait(&barrier);
+#endif
+}
+
+void ProcessBarrier::destroy() {
+#ifndef _MSC_VER
+  pthread_barrier_destroy(&barrier);
+#endif
+}
@@ -0,0 +1,40 @@
+#ifndef SHM_UTILS_H
+#define SHM_UTILS_H
+
+#include <iostream>
+#include "dynet/model.h"
+#ifndef _MSC_VER
+#include <pthread.h>
+#endif
+
+/// Allocate zero-filled memory which stays shared with the processes forked
+/// afterwards. Return nullptr on failure.
+void * shm_alloc(size_t size);
+
+void shm_free(void * ptr, size_t size);
+
+/// Move the values of all the parameters into shared memory so that the
+/// updates made by one forked worker are seen by all the others. Gradients
+/// and optimizer states remain private to each process. Return the shared
+/// block and its size, to be released with shm_free once unshared, or
+/// nullptr if the platform does not support it.
+void * share_parameters(dynet::ParameterCollection & model, size_t & size);
+
+/// Copy the shared values of all the parameters back into private memory of
+/// the calling process, so that it holds a snapshot which the other workers
+/// no longer write. The shared block is left to its other users.
+bool unshare_parameters(dynet::ParameterCollection & model);
+
+/// A barrier for forked processes, it should be placed in shared memory
+/// and initialized before forking.
+struct ProcessBarrier {
+#ifndef _MSC_VER
+  pthread_barrier_t barrier;
+#endif
+
+  void init(unsigned n);
+  void wait();
+  void destroy();
+};
+
+#endif  //  end for SHM_UTILS_H
@@ -365,3 +365,21 @@ void Swap::split(const unsigned & action,
     deprel = (action - 2) / 2;
   }
 }
+
+bool Swap::get_arc(const TransitionState& state,
+                   const unsigned& action,
+                   unsigned& hed,
+                   unsigned& mod,
+                   unsigned& deprel) const {
+  if (is_left(action)) {
+    hed = state.stack.back();
+    mod = state.stack[state.stack.size() - 2];
+  } else if (is_right(action)) {
+    mod = state.stack.back();
+    hed = state.stack[state.stack.size() - 2];
+  } else {
+    return false;
+  }
+  deprel = parse_label(action);
+  return true;
+}
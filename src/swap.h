@@ -42,6 +42,12 @@ struct Swap : public TransitionSystem {
 
   void split(const unsigned & action, unsigned & structure, unsigned & deprel) override;
 
+  bool get_arc(const TransitionState& state,
+               const unsigned& action,
+               unsigned& hed,
+               unsigned& mod,
+               unsigned& deprel) const override;
+
   void get_oracle_actions_calculate_orders(const unsigned & root,
                                            const std::vector<std::vector<unsigned>>& tree,
                                            std::vector<unsigned>& orders,
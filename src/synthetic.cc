@@ -0,0 +1,131 @@
+#include "synthetic.h"
+#include "corpus.h"
+#include "tree.h"
+#include <tuple>
+#include <set>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <boost/lexical_cast.hpp>
+
+unsigned SyntheticTree::random_deprel(unsigned n_deprels,
+                                      unsigned root_deprel,
+                                      std::mt19937 & gen) {
+  if (n_deprels < 2) { return root_deprel; }
+  unsigned deprel = std::uniform_int_distribution<unsigned>(0, n_deprels - 2)(gen);
+  return (deprel >= root_deprel ? deprel + 1 : deprel);
+}
+
+void SyntheticTree::projective(unsigned n,
+                               unsigned n_deprels,
+                               unsigned root_deprel,
+                               std::mt19937 & gen,
+                               std::vector<unsigned> & heads,
+                               std::vector<unsigned> & deprels) {
+  typedef std::tuple<unsigned, unsigned, unsigned> Span;
+  heads.assign(n + 1, Corpus::BAD_HED);
+  deprels.assign(n + 1, Corpus::BAD_DEL);
+  if (n == 0) { return; }
+
+  // each span [begin, end) forms one subtree under the parent, an explicit
+  // stack avoids deep recursion on long sentences.
+  std::vector<Span> spans;
+  spans.push_back(std::make_tuple(0, n, n));
+  while (!spans.empty()) {
+    unsigned begin, end, parent;
+    std::tie(begin, end, parent) = spans.back();
+    spans.pop_back();
+
+    unsigned head = std::uniform_int_distribution<unsigned>(begin, end - 1)(gen);
+    heads[head] = parent;
+    deprels[head] = (parent == n ? root_deprel : random_deprel(n_deprels, root_deprel, gen));
+
+    for (unsigned left = begin; left < head; ) {
+      unsigned right = std::uniform_int_distribution<unsigned>(left + 1, head)(gen);
+      spans.push_back(std::make_tuple(left, right, head));
+      left = right;
+    }
+    for (unsigned left = head + 1; left < end; ) {
+      unsigned right = std::uniform_int_distribution<unsigned>(left + 1, end)(gen);
+      spans.push_back(std::make_tuple(left, right, head));
+      left = right;
+    }
+  }
+}
+
+void SyntheticTree::random(unsigned n,
+                           unsigned n_deprels,
+                           unsigned root_deprel,
+                           std::mt19937 & gen,
+                           std::vector<unsigned> & heads,
+                           std::vector<unsigned> & deprels) {
+  heads.assign(n + 1, Corpus::BAD_HED);
+  deprels.assign(n + 1, Corpus::BAD_DEL);
+  if (n == 0) { return; }
+
+  std::vector<unsigned> order(n);
+  for (unsigned i = 0; i < n; ++i) { order[i] = i; }
+  std::shuffle(order.begin(), order.end(), gen);
+
+  heads[order[0]] = n;
+  deprels[order[0]] = root_deprel;
+  for (unsigned i = 1; i < n; ++i) {
+    unsigned j = std::uniform_int_distribution<unsigned>(0, i - 1)(gen);
+    heads[order[i]] = order[j];
+    deprels[order[i]] = random_deprel(n_deprels, root_deprel, gen);
+  }
+}
+
+SyntheticCorpus::SyntheticCorpus(unsigned n_words,
+                                 double zipf_exponent,
+                                 unsigned n_postags,
+                                 unsigned n_deprels,
+                                 unsigned seed) :
+  n_postags(std::max(n_postags, 1u)),
+  n_deprels(std::max(n_deprels, 1u)) {
+  std::mt19937 gen(seed);
+  // the length of word forms roughly follows that of English words.
+  std::binomial_distribution<unsigned> length_distribution(12, 0.4);
+  std::uniform_int_distribution<int> letter_distribution('a', 'z');
+  std::set<std::string> seen;
+  while (words.size() < n_words) {
+    std::string word(1 + length_distribution(gen), 'a');
+    for (char & c : word) { c = static_cast<char>(letter_distribution(gen)); }
+    if (seen.insert(word).second) { words.push_back(word); }
+  }
+
+  std::vector<double> weights(words.size());
+  for (unsigned r = 0; r < weights.size(); ++r) { weights[r] = 1. / std::pow(r + 1., zipf_exponent); }
+  word_distribution = std::discrete_distribution<unsigned>(weights.begin(), weights.end());
+}
+
+std::string SyntheticCorpus::postag_name(unsigned id) {
+  return "P" + boost::lexical_cast<std::string>(id);
+}
+
+std::string SyntheticCorpus::deprel_name(unsigned id) {
+  return (id == 0 ? std::string("root") : "dep" + boost::lexical_cast<std::string>(id));
+}
+
+std::string SyntheticCorpus::sentence(unsigned n, bool projective, std::mt19937 & gen) {
+  std::vector<unsigned> heads, deprels;
+  if (projective) {
+    SyntheticTree::projective(n, n_deprels, 0, gen, heads, deprels);
+  } else {
+    do {
+      SyntheticTree::random(n, n_deprels, 0, gen, heads, deprels);
+    } while (n > 2 && DependencyUtils::is_projective(heads));
+  }
+
+  std::uniform_int_distribution<unsigned> postag_distribution(0, n_postags - 1);
+  std::ostringstream os;
+  for (unsigned i = 0; i < n; ++i) {
+    const std::string & word = words[word_distribution(gen)];
+    std::string postag = postag_name(postag_distribution(gen));
+    // id form lemma cpos pos feat head deprel phead pdeprel, the head of the
+    // root is the dummy root n, written as 0.
+    os << i + 1 << "\t" << word << "\t" << word << "\t" << postag << "\t" << postag << "\t_\t"
+      << (heads[i] == n ? 0 : heads[i] + 1) << "\t" << deprel_name(deprels[i]) << "\t_\t_\n";
+  }
+  return os.str();
+}
@@ -0,0 +1,61 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <vector>
+#include <string>
+#include <random>
+
+/// Random dependency trees for benchmarks and stress tests. The trees follow
+/// the format of parse_to_vector: n words followed by the dummy root, the
+/// words headed by the dummy root carry root_deprel, the dummy root itself
+/// is headed by Corpus::BAD_HED.
+struct SyntheticTree {
+  /// A random projective tree with a single root, built by recursively
+  /// splitting spans into contiguous subtrees.
+  static void projective(unsigned n,
+                         unsigned n_deprels,
+                         unsigned root_deprel,
+                         std::mt19937 & gen,
+                         std::vector<unsigned> & heads,
+                         std::vector<unsigned> & deprels);
+
+  /// A random tree with a single root, each word attached to a word that
+  /// precedes it in a random order. Not necessarily non-projective.
+  static void random(unsigned n,
+                     unsigned n_deprels,
+                     unsigned root_deprel,
+                     std::mt19937 & gen,
+                     std::vector<unsigned> & heads,
+                     std::vector<unsigned> & deprels);
+
+  /// Draw a random label other than root_deprel.
+  static unsigned random_deprel(unsigned n_deprels,
+                                unsigned root_deprel,
+                                std::mt19937 & gen);
+};
+
+/// Generate sentences in the CoNLL format. The word forms are random strings
+/// drawn from a Zipf distribution over the vocabulary, the POS tags and the
+/// labels are drawn uniformly. The label of the root is named "root".
+struct SyntheticCorpus {
+  std::vector<std::string> words;
+  std::discrete_distribution<unsigned> word_distribution;
+  unsigned n_postags;
+  unsigned n_deprels;
+
+  SyntheticCorpus(unsigned n_words,
+                  double zipf_exponent,
+                  unsigned n_postags,
+                  unsigned n_deprels,
+                  unsigned seed);
+
+  static std::string postag_name(unsigned id);
+  static std::string deprel_name(unsigned id);
+
+  /// One sentence of n words without the trailing empty line. A projective
+  /// tree is generated unless projective is false, in which case the tree
+  /// is resampled until it is non-projective (if n > 2).
+  std::string sentence(unsigned n, bool projective, std::mt19937 & gen);
+};
+
+#endif  //  end for SYNTHETIC_H
@@ -1,5 +1,6 @@
 #include "system.h"
 #include "corpus.h"
+#include "label_pruner.h"
 
 
 TransitionState::TransitionState(unsigned n) :
@@ -18,3 +19,10 @@ void TransitionState::initialize(const InputUnits & input) {
 bool TransitionState::terminated() const {
   return !(stack.size() > 2 || buffer.size() > 1);
 }
+
+void TransitionSystem::get_decoding_actions(const TransitionState& state,
+                                            const InputUnits& input,
+                                            std::vector<unsigned>& valid_actions) {
+  get_valid_actions(state, valid_actions);
+  if (label_pruner != nullptr) { label_pruner->prune(*this, state, input, valid_actions); }
+}
@@ -18,10 +18,14 @@ struct TransitionState {
   bool terminated() const;
 };
 
+struct LabelPruner;
+
 struct TransitionSystem {
   const Alphabet& deprel_map;
+  /// If set, prunes the labels of the actions at decoding.
+  const LabelPruner * label_pruner;
 
-  TransitionSystem(const Alphabet& map) : deprel_map(map) {}
+  TransitionSystem(const Alphabet& map) : deprel_map(map), label_pruner(nullptr) {}
  
   virtual std::string system_name() const = 0;
 
@@ -51,6 +55,19 @@ struct TransitionSystem {
                                   std::vector<unsigned>& actions) = 0;
 
   virtual void split(const unsigned & action, unsigned & structure, unsigned & deprel) = 0;
+
+  /// Get the arc that a valid action builds on the state, return false if
+  /// the action builds no arc.
+  virtual bool get_arc(const TransitionState& state,
+                       const unsigned& action,
+                       unsigned& hed,
+                       unsigned& mod,
+                       unsigned& deprel) const = 0;
+
+  /// The valid actions considered by the decoders, pruned by the label pruner if set.
+  void get_decoding_actions(const TransitionState& state,
+                            const InputUnits& input,
+                            std::vector<unsigned>& valid_actions);
 };
 
 #endif  //  end for SYSTEM_H
@@ -4,12 +4,15 @@
 #include "arceager.h"
 #include "archybrid.h"
 #include "swap.h"
+#include "label_pruner.h"
 
 po::options_description TransitionSystemBuilder::get_options() {
   po::options_description cmd("Transition system options");
   cmd.add_options()
     ("system", po::value<std::string>()->default_value("arcstd"), "The transition system [arcstd, arceager, archybrid, swap].")
     ("root", po::value<std::string>()->default_value("root"), "The root relation name.")
+    ("label_pruning", "At decoding, only keep the labels seen in the training data between the POS of the head and the modifier.")
+    ("label_pruning_min_count", po::value<unsigned>()->default_value(1), "The number of times a label should be seen to be kept.")
     ;
 
   return cmd;
@@ -35,6 +38,13 @@ TransitionSystem * TransitionSystemBuilder::build(const po::variables_map & conf
     exit(1);
   }
   _INFO << "SysBuilder:: transition system: " << system_name;
+  if (conf.count("label_pruning")) {
+    // the statistics are taken from the training data loaded so far.
+    LabelPruner * pruner = new LabelPruner(corpus.pos_map.size(), corpus.deprel_map.size(),
+                                           conf["label_pruning_min_count"].as<unsigned>());
+    pruner->build(corpus);
+    sys->label_pruner = pruner;
+  }
   return sys;
 }
 
@@ -0,0 +1,83 @@
+#include "trace.h"
+#include "logging.h"
+#include "sys_utils.h"
+#include <algorithm>
+
+po::options_description Tracer::get_options() {
+  po::options_description cmd("Trace options");
+  cmd.add_options()
+    ("trace", po::value<std::string>(), "Write a timeline of the parsing and training phases in Chrome trace-event format.")
+    ("trace_every", po::value<unsigned>()->default_value(100), "Only trace every n-th sentence.")
+    ;
+  return cmd;
+}
+
+Tracer & Tracer::instance() {
+  static Tracer tracer;
+  return tracer;
+}
+
+Tracer::Tracer() :
+  enabled(false), sampling(false), every(1), n_sentences(0), pid(0), ofs(nullptr), n_written(0) {
+}
+
+Tracer::~Tracer() {
+  dump();
+}
+
+void Tracer::initialize(const po::variables_map & conf) {
+  if (!conf.count("trace")) { return; }
+  path = conf["trace"].as<std::string>();
+  every = (conf.count("trace_every") ? std::max(conf["trace_every"].as<unsigned>(), 1u) : 100);
+  ofs = new std::ofstream(path);
+  if (!ofs->good()) {
+    _WARN << "Trace:: failed to open " << path << ", tracing disabled.";
+    delete ofs;
+    ofs = nullptr;
+    return;
+  }
+  ofs->setf(std::ios::fixed);
+  ofs->precision(3);
+  (*ofs) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  events.reserve(kFlushEvents);
+  enabled = true;
+  pid = portable_getpid();
+  origin = Clock::now();
+  _INFO << "Trace:: write timeline to " << path << ", every " << every << " sentence(s).";
+}
+
+void Tracer::next_sentence() {
+  sampling = (enabled && (n_sentences++ % every == 0));
+}
+
+void Tracer::add(const char * name, const Clock::time_point & begin, const Clock::time_point & end) {
+  Event event;
+  event.name = name;
+  event.ts = std::chrono::duration<double, std::micro>(begin - origin).count();
+  event.dur = std::chrono::duration<double, std::micro>(end - begin).count();
+  events.push_back(event);
+  if (events.size() >= kFlushEvents) { flush(); }
+}
+
+void Tracer::flush() {
+  if (!enabled) { return; }
+  // the events of a forked worker are dropped.
+  if (pid != portable_getpid()) { events.clear(); return; }
+  for (const Event & event : events) {
+    (*ofs) << (n_written++ > 0 ? ",\n" : "\n")
+      << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":" << pid
+      << ",\"tid\":0,\"ts\":" << event.ts << ",\"dur\":" << event.dur << "}";
+  }
+  events.clear();
+}
+
+void Tracer::dump() {
+  // only the process that enabled the tracer writes the timeline.
+  if (!enabled || pid != portable_getpid()) { return; }
+  flush();
+  (*ofs) << "\n]}" << std::endl;
+  delete ofs;
+  ofs = nullptr;
+  enabled = false;
+  sampling = false;
+}
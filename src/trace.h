@@ -0,0 +1,92 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <iostream>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+/// Record scoped spans into a timeline in the Chrome trace-event format,
+/// which can be loaded by chrome://tracing or Perfetto. Per-sentence spans
+/// are only recorded on every N-th sentence; the others cost a branch. The
+/// events are buffered and appended to the timeline every kFlushEvents, so
+/// the memory stays bounded; forked workers drop theirs and do not write.
+struct Tracer {
+  static const unsigned kFlushEvents = 4096;
+
+  typedef std::chrono::high_resolution_clock Clock;
+
+  struct Event {
+    const char * name;
+    double ts;    // in microseconds.
+    double dur;
+  };
+
+  std::string path;
+  bool enabled;
+  bool sampling;
+  unsigned every;
+  unsigned n_sentences;
+  int pid;
+  Clock::time_point origin;
+  /// the events not yet written.
+  std::vector<Event> events;
+  /// owned by the process that enabled the tracer, a forked copy never closes it.
+  std::ofstream * ofs;
+  unsigned n_written;
+
+  static po::options_description get_options();
+
+  static Tracer & instance();
+
+  Tracer();
+
+  ~Tracer();
+
+  void initialize(const po::variables_map & conf);
+
+  /// Called at the beginning of each sentence, decide whether its spans are recorded.
+  void next_sentence();
+
+  void add(const char * name, const Clock::time_point & begin, const Clock::time_point & end);
+
+  /// Append the buffered events to the timeline.
+  void flush();
+
+  /// Flush and close the timeline.
+  void dump();
+};
+
+/// Record the lifetime of this object as one span. A global span (e.g. loading,
+/// evaluation) is recorded whenever tracing is enabled, a per-sentence span
+/// only when the current sentence is sampled.
+struct TraceSpan {
+  const char * name;
+  bool active;
+  Tracer::Clock::time_point begin;
+
+  TraceSpan(const char * name, bool global = false) : name(name) {
+    Tracer & tracer = Tracer::instance();
+    active = (global ? tracer.enabled : tracer.sampling);
+    if (active) { begin = Tracer::Clock::now(); }
+  }
+
+  ~TraceSpan() {
+    if (active) { Tracer::instance().add(name, begin, Tracer::Clock::now()); }
+  }
+
+  /// Close the current span and open the next one, to trace consecutive statements.
+  void next(const char * next_name) {
+    if (active) {
+      Tracer::Clock::time_point now = Tracer::Clock::now();
+      Tracer::instance().add(name, begin, now);
+      begin = now;
+    }
+    name = next_name;
+  }
+};
+
+#endif  //  end for TRACE_H
@@ -0,0 +1,114 @@
+#include "train_stats.h"
+#include "shm_utils.h"
+#include <sstream>
+#include <algorithm>
+
+static const char * phase_names[] = {
+  "construct", "forward", "backward", "update", "oracle", "evaluate"
+};
+
+TrainStats::TrainStats() : slots(nullptr), n_ranks(1), rank(0) {
+  reset();
+}
+
+void TrainStats::reset() {
+  n_sentences = 0;
+  n_tokens = 0;
+  n_transitions = 0;
+  std::fill(elapsed, elapsed + kNumPhases, 0.);
+  peak_fxs = 0;
+  peak_dedfs = 0;
+  start = Clock::now();
+  last = start;
+  if (slots != nullptr) { base = sum_slots(); }
+}
+
+void TrainStats::tick() {
+  last = Clock::now();
+}
+
+void TrainStats::tock(PHASE phase) {
+  Clock::time_point now = Clock::now();
+  double d = std::chrono::duration<double, std::milli>(now - last).count();
+  elapsed[phase] += d;
+  if (slots != nullptr) { slots[rank].elapsed[phase] += d; }
+  last = now;
+}
+
+void TrainStats::add_sentence(unsigned n_tokens_, unsigned n_transitions_) {
+  n_sentences++;
+  n_tokens += n_tokens_;
+  n_transitions += n_transitions_;
+  if (slots != nullptr) {
+    Slot & slot = slots[rank];
+    slot.n_sentences += 1;
+    slot.n_tokens += n_tokens_;
+    slot.n_transitions += n_transitions_;
+  }
+}
+
+void TrainStats::sample_memory() {
+  high_water.sample();
+  peak_fxs = std::max(peak_fxs, arena_used_fxs());
+  peak_dedfs = std::max(peak_dedfs, arena_used_dedfs());
+}
+
+bool TrainStats::share(unsigned n) {
+  unshare();
+  slots = static_cast<Slot *>(shm_alloc(sizeof(Slot) * n));
+  if (slots == nullptr) { return false; }
+  n_ranks = n;
+  rank = 0;
+  base = sum_slots();
+  return true;
+}
+
+void TrainStats::unshare() {
+  if (slots == nullptr) { return; }
+  shm_free(slots, sizeof(Slot) * n_ranks);
+  slots = nullptr;
+  n_ranks = 1;
+  rank = 0;
+}
+
+TrainStats::Slot TrainStats::sum_slots() const {
+  Slot sum;
+  sum.n_sentences = sum.n_tokens = sum.n_transitions = 0.;
+  std::fill(sum.elapsed, sum.elapsed + kNumPhases, 0.);
+  for (unsigned k = 0; k < n_ranks; ++k) {
+    const Slot & slot = slots[k];
+    sum.n_sentences += slot.n_sentences;
+    sum.n_tokens += slot.n_tokens;
+    sum.n_transitions += slot.n_transitions;
+    for (unsigned i = 0; i < kNumPhases; ++i) { sum.elapsed[i] += slot.elapsed[i]; }
+  }
+  return sum;
+}
+
+std::string TrainStats::report() const {
+  double total = std::chrono::duration<double>(Clock::now() - start).count();
+  if (total <= 0.) { total = 1e-9; }
+  double sents = n_sentences, tokens = n_tokens, transitions = n_transitions;
+  double phases[kNumPhases];
+  std::copy(elapsed, elapsed + kNumPhases, phases);
+  if (slots != nullptr) {
+    // the other ranks keep on counting, the sum is approximate.
+    Slot sum = sum_slots();
+    sents = sum.n_sentences - base.n_sentences;
+    tokens = sum.n_tokens - base.n_tokens;
+    transitions = sum.n_transitions - base.n_transitions;
+    for (unsigned i = 0; i < kNumPhases; ++i) { phases[i] = sum.elapsed[i] - base.elapsed[i]; }
+  }
+  std::ostringstream os;
+  os << sents / total << " sent/s, "
+    << tokens / total << " tok/s, "
+    << transitions / total << " trans/s [";
+  for (unsigned i = 0; i < kNumPhases; ++i) {
+    if (i > 0) { os << ", "; }
+    os << phase_names[i] << " " << phases[i] << " ms";
+  }
+  os << "]";
+  if (slots != nullptr) { os << " summed over " << n_ranks << " ranks,"; }
+  os << " peak mem fxs " << (peak_fxs >> 20) << " MB, dedfs " << (peak_dedfs >> 20) << " MB";
+  return os.str();
+}
@@ -0,0 +1,69 @@
+#ifndef TRAIN_STATS_H
+#define TRAIN_STATS_H
+
+#include <iostream>
+#include <chrono>
+#include "memory_utils.h"
+
+/// Throughput and time breakdown of training between two reports. The
+/// counters are plain additions, timing a phase costs one clock read. When
+/// shared, the forked workers (or replicas) also add their counters to their
+/// own slot in shared memory and the report sums the slots of all the ranks;
+/// the peak memory stays that of the reporting process.
+struct TrainStats {
+  enum PHASE { kConstruct, kForward, kBackward, kUpdate, kOracle, kEvaluate, kNumPhases };
+  typedef std::chrono::high_resolution_clock Clock;
+
+  /// The counters of one rank since sharing, only ever increased.
+  struct Slot {
+    double n_sentences;
+    double n_tokens;
+    double n_transitions;
+    double elapsed[kNumPhases];
+  };
+
+  unsigned n_sentences;
+  unsigned n_tokens;
+  unsigned n_transitions;
+  double elapsed[kNumPhases];   // in milliseconds.
+  size_t peak_fxs;
+  size_t peak_dedfs;
+  /// per-sentence arena high-water marks, not cleared by reset().
+  ArenaHighWater high_water;
+  Clock::time_point start;
+  Clock::time_point last;
+  Slot * slots;
+  unsigned n_ranks;
+  unsigned rank;
+  /// the sum of the slots at the last reset.
+  Slot base;
+
+  TrainStats();
+
+  void reset();
+
+  /// Start timing a phase.
+  void tick();
+
+  /// Account the time since the last tick (or tock) to the phase.
+  void tock(PHASE phase);
+
+  void add_sentence(unsigned n_tokens, unsigned n_transitions);
+
+  /// Record the usage of the dynet arenas, should be called once per sentence
+  /// while its graph is alive.
+  void sample_memory();
+
+  /// Allocate the slots of n ranks in shared memory, should be called before
+  /// forking. Return false if the platform does not support it.
+  bool share(unsigned n);
+
+  void unshare();
+
+  std::string report() const;
+
+private:
+  Slot sum_slots() const;
+};
+
+#endif  //  end for TRAIN_STATS_H
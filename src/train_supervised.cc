@@ -3,6 +3,28 @@
 #include "tree.h"
 #include "logging.h"
 #include "evaluate.h"
+#include "async_evaluator.h"
+#include "shm_utils.h"
+#include "grad_allreduce.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <new>
+#ifndef _MSC_VER
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+/* The state shared by the training workers of one iteration. */
+struct SharedWorkerState {
+  static const unsigned kMaxWorkers = 256;
+  std::atomic<unsigned> cursor;
+  std::atomic<unsigned> done;
+  std::atomic<unsigned> turn;
+  ProcessBarrier barrier;
+  float loss[kMaxWorkers];
+};
 
 po::options_description SupervisedTrainer::get_options() {
   po::options_description cmd("Supervised options");
@@ -12,6 +34,15 @@ po::options_description SupervisedTrainer::get_options() {
     ("supervised_do_pretrain_iter", po::value<unsigned>()->default_value(1), "The number of pretrain iteration on dynamic oracle.")
     ("supervised_do_explore_prob", po::value<float>()->default_value(0.9), "The probability of exploration.")
     ("supervised_pretrain_iter", po::value<unsigned>()->default_value(5), "The number of iteration with greedy parser pretraining, only used when objective is `structure`.")
+    ("batch_size", po::value<unsigned>()->default_value(1), "The number of sentences whose gradients are accumulated before one update.")
+    ("batch_tokens", po::value<unsigned>()->default_value(0), "If set, close a batch once it reaches this number of tokens instead of --batch_size sentences.")
+    ("order_bucket_width", po::value<unsigned>()->default_value(0), "If set, shuffle the sentences within buckets of this length width and then the buckets, instead of a full shuffle.")
+    ("train_threads", po::value<unsigned>()->default_value(1), "The number of training workers updating the shared parameters without locking.")
+    ("train_threads_deterministic", po::value<bool>()->default_value(false), "Assign the sentences and apply the updates of the training workers in a fixed order.")
+    ("workers", po::value<unsigned>()->default_value(1), "The number of model replicas trained synchronously, each takes its share of every batch.")
+    ("supervised_actors", po::value<unsigned>()->default_value(0), "The number of actors rolling out with the dynamic oracle, 0 for rolling out in the learner.")
+    ("supervised_actor_refresh", po::value<unsigned>()->default_value(200), "The number of sentences rolled out from one snapshot of the parameters.")
+    ("supervised_drop_forced", "Leave the transitions with a single valid action out of the loss, they are performed without scoring.")
     ;
   return cmd;
 }
@@ -20,9 +51,62 @@ SupervisedTrainer::SupervisedTrainer(const po::variables_map& conf,
                                      const Noisifier& noisifier,
                                      ParserStateBuilder & state_builder) :
   state_builder(state_builder),
-  noisifier(noisifier) {
-  lambda_ = conf["lambda"].as<float>();
-  _INFO << "SUP:: lambda = " << lambda_;
+  noisifier(noisifier),
+  regularizer(conf, state_builder.model, "SUP"),
+  n_batch_sents(0),
+  n_batch_tokens(0) {
+
+  batch_size = std::max(conf["batch_size"].as<unsigned>(), 1u);
+  batch_tokens = conf["batch_tokens"].as<unsigned>();
+  if (batch_tokens > 0) {
+    _INFO << "SUP:: batch by tokens, budget = " << batch_tokens;
+  } else {
+    _INFO << "SUP:: batch size = " << batch_size;
+  }
+  bucket_width = conf["order_bucket_width"].as<unsigned>();
+  if (bucket_width > 0) {
+    _INFO << "SUP:: shuffle within length buckets, width = " << bucket_width;
+  }
+
+  n_workers = std::max(conf["train_threads"].as<unsigned>(), 1u);
+  deterministic = conf["train_threads_deterministic"].as<bool>();
+#ifdef _MSC_VER
+  if (n_workers > 1) {
+    _WARN << "SUP:: multiple training workers are not supported, fallback to single worker.";
+    n_workers = 1;
+  }
+#endif
+  if (n_workers > SharedWorkerState::kMaxWorkers) {
+    _WARN << "SUP:: number of training workers truncated to " << SharedWorkerState::kMaxWorkers;
+    n_workers = SharedWorkerState::kMaxWorkers;
+  }
+  n_replicas = std::max(conf["workers"].as<unsigned>(), 1u);
+#ifdef _MSC_VER
+  if (n_replicas > 1) {
+    _WARN << "SUP:: multiple replicas are not supported, fallback to single process.";
+    n_replicas = 1;
+  }
+#endif
+  if (n_workers > 1 && n_replicas > 1) {
+    _ERROR << "SUP:: --train_threads and --workers can not be used together.";
+    exit(1);
+  }
+  if (n_replicas > 1) {
+    _INFO << "SUP:: synchronous replicas = " << n_replicas;
+    if (batch_tokens == 0 && batch_size < n_replicas) {
+      // otherwise some replicas would never get a sentence.
+      _WARN << "SUP:: batch size " << batch_size << " is less than the replicas, set to " << n_replicas;
+      batch_size = n_replicas;
+    }
+    if (regularizer.decay) {
+      // the replicas only share the summed gradient, not the weight of the regularizer.
+      _WARN << "SUP:: weight decay is not supported with replicas, fallback to the graph mode.";
+      regularizer.decay = false;
+    }
+  }
+  if (n_workers > 1) {
+    _INFO << "SUP:: training workers = " << n_workers << (deterministic ? " (deterministic)" : "");
+  }
 
   if (conf["supervised_oracle"].as<std::string>() == "static") {
     oracle_type = kStatic;
@@ -55,6 +139,26 @@ SupervisedTrainer::SupervisedTrainer(const po::variables_map& conf,
     _INFO << "SUP:: pretrain iteration = " << do_pretrain_iter;
     _INFO << "SUP:: explore prob = " << do_explore_prob;
   }
+
+  n_actors = conf["supervised_actors"].as<unsigned>();
+  actor_refresh = std::max(conf["supervised_actor_refresh"].as<unsigned>(), 1u);
+#ifdef _MSC_VER
+  if (n_actors > 0) {
+    _WARN << "SUP:: actors are not supported, roll out in the learner.";
+    n_actors = 0;
+  }
+#endif
+  if (n_actors > 0 && (oracle_type != kDynamic || n_workers > 1 || n_replicas > 1)) {
+    _WARN << "SUP:: actors only work with a single dynamic oracle learner, disabled.";
+    n_actors = 0;
+  }
+  if (n_actors > 0) {
+    _INFO << "SUP:: actors = " << n_actors << ", refreshed every " << actor_refresh << " sentences";
+  }
+  drop_forced = (conf.count("supervised_drop_forced") > 0);
+  if (drop_forced) {
+    _INFO << "SUP:: forced transitions are left out of the loss.";
+  }
 }
 
 void SupervisedTrainer::train(const po::variables_map& conf,
@@ -84,66 +188,330 @@ void SupervisedTrainer::train(const po::variables_map& conf,
   if (objective_type == kStructure) {
     pretrain_iter = conf["supervised_pretrain_iter"].as<unsigned>();
   }
+  size_t shared_size = 0;
+  void * shared_params = (n_workers > 1 ? share_parameters(model, shared_size) : nullptr);
+  if (n_workers > 1 && shared_params == nullptr) {
+    _WARN << "SUP:: failed to share parameters, fallback to single worker.";
+    n_workers = 1;
+  }
+  AsyncEvaluator evaluator(conf, model, name);
+  evaluator.set_shared(n_workers > 1);
+  // the free-running workers are never stopped within an iteration, so they
+  // are only evaluated once all of them have joined.
+  bool evaluate_in_iter = (n_workers == 1 || deterministic);
+  if (!evaluate_in_iter) {
+    _INFO << "SUP:: free-running workers, evaluate at the end of each iteration only.";
+  }
+
+  unsigned n_ranks = std::max(n_workers, n_replicas);
+  if (n_ranks > 1 && !stats.share(n_ranks)) {
+    _WARN << "SUP:: failed to share the training stats, only the first rank is reported.";
+  }
+
+  // the replicas shuffle with their own generator so that they agree on the
+  // order whatever randomness each of them consumes during training.
+  std::mt19937 * shuffle_engine = dynet::rndeng;
+  std::mt19937 replica_engine;
+  GradientAllReducer * reducer = nullptr;
+  std::vector<int> replicas;
+  unsigned rank = 0;
+#ifndef _MSC_VER
+  if (n_replicas > 1) {
+    reducer = new GradientAllReducer(model, n_replicas);
+    replica_engine.seed((*dynet::rndeng)());
+    shuffle_engine = (&replica_engine);
+    unsigned seed = (*dynet::rndeng)();
+    for (unsigned k = 1; k < n_replicas; ++k) {
+      pid_t pid = fork();
+      if (pid < 0) {
+        _ERROR << "SUP:: failed to fork replica #" << k;
+        exit(1);
+      }
+      if (pid == 0) { rank = k; break; }
+      replicas.push_back(pid);
+    }
+    stats.rank = rank;
+    dynet::rndeng->seed(seed + rank);
+  }
+#endif
+  auto on_evaluated = [&best_f](float f) -> bool {
+    if (f <= best_f) { return false; }
+    best_f = f;
+    _INFO << "SUP:: new best record achieved: " << best_f << ", saved.";
+    return true;
+  };
+
   _INFO << "SUP:: will stop after " << max_iter << " iterations.";
   for (unsigned iter = 0; iter < max_iter; ++iter) {
     llh = 0;
     bool structure_learn = (objective_type == kStructure && iter >= pretrain_iter);
-    _INFO << "SUP:: start training iteration #" << iter << ", shuffled.";
-    std::shuffle(order.begin(), order.end(), (*dynet::rndeng));
-
-    for (unsigned sid : order) {
+    auto evaluate_func = [&, structure_learn]() -> float {
+      return (beam_size > 1 ?
+              beam_search(conf, corpus, state_builder, output, structure_learn) :
+              evaluate(conf, corpus, state_builder, output));
+    };
+    auto train_func = [&, structure_learn](unsigned sid) -> float {
       InputUnits& input_units = corpus.training_inputs[sid];
       const ParseUnits& parse_units = corpus.training_parses[sid];
-      
+
       noisifier.noisify(input_units);
       float lp;
       if (!allow_partial_tree) {
         if (structure_learn) {
-          lp = train_structure_full_tree(input_units, parse_units, trainer, beam_size, iter);
+          lp = train_structure_full_tree(input_units, parse_units, beam_size, iter);
         } else {
-          lp = train_full_tree(input_units, parse_units, trainer, iter);
+          lp = train_full_tree(input_units, parse_units, iter);
         }
       } else {
-        lp = train_partial_tree(input_units, parse_units, trainer, iter);
+        lp = train_partial_tree(input_units, parse_units, iter);
       }
-
+      noisifier.denoisify(input_units);
+      return lp;
+    };
+    auto report_func = [&](float lp) {
+      // only the first replica reports and evaluates.
+      if (rank != 0) { return; }
       llh += lp;
       llh_in_batch += lp;
-      noisifier.denoisify(input_units);
 
-      ++logc; 
+      ++logc;
       if (logc % report_stops == 0) {
         float epoch = (float(logc) / n_train);
         _INFO << "SUP:: iter #" << iter << " (epoch " << epoch << ") loss " << llh_in_batch;
+        _INFO << "SUP:: " << stats.report();
         llh_in_batch = 0.f;
+        stats.reset();
       }
-      if (iter >= evaluate_skips && logc % evaluate_stops == 0) {
-        float f = (beam_size > 1 ? 
-                   beam_search(conf, corpus, state_builder, output, structure_learn) :
-                   evaluate(conf, corpus, state_builder, output));
-        if (f > best_f) {
-          best_f = f;
-          _INFO << "SUP:: new best record achieved: " << best_f << ", saved.";
-          dynet::save_dynet_model(name, (&model));
-        }
+      if (evaluate_in_iter && iter >= evaluate_skips && logc % evaluate_stops == 0) {
+        flush(trainer);
+        regularizer.flush();
+        stats.tick();
+        evaluator.evaluate(evaluate_func, on_evaluated);
+        stats.tock(TrainStats::kEvaluate);
       }
+      evaluator.poll();
+    };
+    _INFO << "SUP:: start training iteration #" << iter << ", shuffled.";
+    shuffle_orders(corpus, order, bucket_width, (*shuffle_engine));
+
+    if (n_workers > 1) {
+      train_workers(corpus, order, trainer, train_func, report_func);
+    } else if (n_replicas > 1) {
+      train_replicas(corpus, order, trainer, reducer, rank, train_func, report_func);
+    } else if (n_actors > 0 && !structure_learn && !allow_partial_tree) {
+      train_actor_learner(corpus, order, trainer, iter, report_func);
+    } else {
+      for (unsigned sid : order) {
+        float lp = train_func(sid);
+        step(trainer, corpus.training_inputs[sid].size());
+        report_func(lp);
+      }
+      flush(trainer);
     }
 
-    _INFO << "SUP:: end of iter #" << iter << " loss " << llh;
-    float f = (beam_size > 1 ? 
-               beam_search(conf, corpus, state_builder, output, structure_learn) :
-               evaluate(conf, corpus, state_builder, output));
-    if (f > best_f) {
-      best_f = f;
-      _INFO << "SUP:: new best record achieved: " << best_f << ", saved.";
-      dynet::save_dynet_model(name, (&model));
+    regularizer.flush();
+    if (rank == 0) {
+      _INFO << "SUP:: end of iter #" << iter << " loss " << llh;
+      _INFO << "SUP:: arena high-water " << stats.high_water.to_json();
+      stats.high_water.clear();
+      stats.tick();
+      evaluator.evaluate(evaluate_func, on_evaluated);
+      stats.tock(TrainStats::kEvaluate);
     }
     update_trainer(conf, eta0, static_cast<float>(iter) + 1.f, trainer);
   }
+#ifndef _MSC_VER
+  if (rank != 0) { _exit(0); }
+  for (int pid : replicas) {
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      _ERROR << "SUP:: training replica " << pid << " failed.";
+    }
+  }
+#endif
+  evaluator.wait();
+  stats.unshare();
+  // the workers are done, bring the parameters back to private memory.
+  if (shared_params != nullptr) {
+    if (unshare_parameters(model)) {
+      shm_free(shared_params, shared_size);
+    } else {
+      _WARN << "SUP:: failed to unshare parameters, keep them in shared memory.";
+    }
+  }
 
+  delete reducer;
   delete trainer;
 }
 
+void SupervisedTrainer::train_replicas(Corpus & corpus,
+                                       const std::vector<unsigned> & order,
+                                       dynet::Trainer * trainer,
+                                       GradientAllReducer * reducer,
+                                       unsigned rank,
+                                       const std::function<float(unsigned)> & train_func,
+                                       const std::function<void(float)> & report_func) {
+  unsigned n = order.size();
+  for (unsigned begin = 0; begin < n; ) {
+    // every replica cuts the same batches. the i-th sentence of a batch goes
+    // to the replica (i mod n_replicas), or, when batching by tokens, to the
+    // replica with the fewest tokens so far.
+    unsigned end = begin, n_tokens = 0;
+    while (end < n) {
+      n_tokens += corpus.training_inputs[order[end]].size();
+      ++end;
+      if (batch_tokens > 0 ? n_tokens >= batch_tokens : end - begin >= batch_size) { break; }
+    }
+    float lp = 0.f;
+    if (batch_tokens > 0) {
+      std::vector<unsigned> load(n_replicas, 0);
+      for (unsigned i = begin; i < end; ++i) {
+        unsigned r = std::min_element(load.begin(), load.end()) - load.begin();
+        load[r] += corpus.training_inputs[order[i]].size();
+        if (r == rank) { lp += train_func(order[i]); }
+      }
+    } else {
+      for (unsigned i = begin + rank; i < end; i += n_replicas) { lp += train_func(order[i]); }
+    }
+    lp = reducer->all_reduce(rank, lp);
+    stats.tick();
+    trainer->update();
+    regularizer.update(trainer->learning_rate);
+    stats.tock(TrainStats::kUpdate);
+    for (unsigned i = begin; i < end; ++i) { report_func(i + 1 == end ? lp : 0.f); }
+    begin = end;
+  }
+}
+
+void SupervisedTrainer::train_workers(Corpus & corpus,
+                                      const std::vector<unsigned> & order,
+                                      dynet::Trainer * trainer,
+                                      const std::function<float(unsigned)> & train_func,
+                                      const std::function<void(float)> & report_func) {
+#ifndef _MSC_VER
+  void * mem = shm_alloc(sizeof(SharedWorkerState));
+  if (mem == nullptr) {
+    _ERROR << "SUP:: failed to allocate shared memory for workers.";
+    exit(1);
+  }
+  // construct the atomics in place, the raw memory is no object yet.
+  SharedWorkerState * shared = new (mem) SharedWorkerState();
+  shared->cursor = 0;
+  shared->done = 0;
+  shared->turn = 0;
+  if (deterministic) { shared->barrier.init(n_workers); }
+
+  // seeds are drawn from the main generator so that the whole run is
+  // reproducible given --dynet-seed.
+  unsigned seed = (*dynet::rndeng)();
+  std::vector<pid_t> children;
+  unsigned rank = 0;
+  for (unsigned k = 1; k < n_workers; ++k) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      _ERROR << "SUP:: failed to fork worker #" << k;
+      exit(1);
+    }
+    if (pid == 0) { rank = k; break; }
+    children.push_back(pid);
+  }
+  stats.rank = rank;
+  dynet::rndeng->seed(seed + rank);
+
+  unsigned n = order.size();
+  unsigned reported = 0;
+  float loss_reported = 0.f;
+  // only the first worker (the main process) reports and evaluates.
+  auto sync_report = [&](unsigned n_done) {
+    if (rank != 0) { return; }
+    float loss = 0.f;
+    for (unsigned k = 0; k < n_workers; ++k) { loss += shared->loss[k]; }
+    for (; reported < n_done; ++reported) {
+      report_func(reported + 1 == n_done ? loss - loss_reported : 0.f);
+    }
+    loss_reported = loss;
+  };
+
+  if (!deterministic) {
+    unsigned i;
+    while ((i = shared->cursor.fetch_add(1)) < n) {
+      unsigned sid = order[i];
+      shared->loss[rank] += train_func(sid);
+      step(trainer, corpus.training_inputs[sid].size());
+      shared->done.fetch_add(1);
+      sync_report(shared->done.load());
+    }
+    flush(trainer);
+  } else {
+    // the workers compute the gradients of one round in parallel, then
+    // update the parameters one after another in the order of their ranks.
+    unsigned n_rounds = (n + n_workers - 1) / n_workers;
+    for (unsigned r = 0; r <= n_rounds; ++r) {
+      unsigned i = r * n_workers + rank;
+      bool has_sentence = (r < n_rounds && i < n);
+      float lp = (has_sentence ? train_func(order[i]) : 0.f);
+      shared->barrier.wait();
+      while (shared->turn.load() != rank) { sched_yield(); }
+      if (has_sentence) {
+        shared->loss[rank] += lp;
+        step(trainer, corpus.training_inputs[order[i]].size());
+      } else if (r == n_rounds) {
+        flush(trainer);
+      }
+      shared->turn.fetch_add(1);
+      if (rank == 0) {
+        // report (and evaluate) while the other workers are held.
+        while (shared->turn.load() != n_workers) { sched_yield(); }
+        shared->turn = 0;
+        sync_report(std::min(n, (r + 1) * n_workers));
+      }
+      shared->barrier.wait();
+    }
+  }
+
+  // the other workers leave with their deferred decay applied.
+  regularizer.flush();
+  if (rank != 0) { _exit(0); }
+  for (pid_t pid : children) {
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      _ERROR << "SUP:: training worker " << pid << " failed.";
+      exit(1);
+    }
+  }
+  sync_report(n);
+  if (deterministic) { shared->barrier.destroy(); }
+  shared->~SharedWorkerState();
+  shm_free(mem, sizeof(SharedWorkerState));
+#endif
+}
+
+void SupervisedTrainer::step(dynet::Trainer * trainer, unsigned n_tokens) {
+  n_batch_sents++;
+  n_batch_tokens += n_tokens;
+  bool full = (batch_tokens > 0 ? n_batch_tokens >= batch_tokens : n_batch_sents >= batch_size);
+  if (full) { flush(trainer); }
+}
+
+void SupervisedTrainer::flush(dynet::Trainer * trainer) {
+  if (n_batch_sents == 0) { return; }
+  stats.tick();
+  {
+    TraceSpan span("update");
+    trainer->update();
+    regularizer.update(trainer->learning_rate);
+  }
+  stats.tock(TrainStats::kUpdate);
+  n_batch_sents = 0;
+  n_batch_tokens = 0;
+}
+
+bool SupervisedTrainer::forced_without_loss(const std::vector<unsigned> & valid_actions) const {
+  if (valid_actions.size() != 1) { return false; }
+  // the rank losses need a non-gold action.
+  return (drop_forced || objective_type == kRank || objective_type == kBipartieRank);
+}
+
 void SupervisedTrainer::add_loss_one_step(dynet::Expression & score_expr,
                                           const unsigned & best_gold_action,
                                           const unsigned & worst_gold_action,
@@ -171,9 +539,257 @@ void SupervisedTrainer::add_loss_one_step(dynet::Expression & score_expr,
   }
 }
 
+/* One exploring rollout recorded by an actor, each step is stored as
+   (action, best gold action, worst gold action, best non-gold action). The
+   word ids are those of the noisified input the actor explored on. */
+struct Trajectory {
+  unsigned sid;
+  std::vector<unsigned> wids;
+  std::vector<unsigned> steps;
+};
+
+void SupervisedTrainer::train_actor_learner(Corpus & corpus,
+                                            const std::vector<unsigned> & order,
+                                            dynet::Trainer * trainer,
+                                            unsigned iter,
+                                            const std::function<void(float)> & report_func) {
+#ifndef _MSC_VER
+  struct Actors {
+    unsigned begin, end;
+    std::vector<int> pids;
+    std::vector<FILE *> files;
+  };
+  unsigned n = order.size();
+
+  // fork the actors, each holds a snapshot of the current parameters and
+  // rolls out its share of order[begin, end).
+  auto launch = [&](unsigned begin) -> Actors {
+    Actors actors;
+    actors.begin = begin;
+    actors.end = std::min(n, begin + actor_refresh);
+    unsigned seed = (*dynet::rndeng)();
+    for (unsigned k = 0; k < n_actors; ++k) {
+      FILE * fp = std::tmpfile();
+      if (fp == nullptr) {
+        _ERROR << "SUP:: failed to create trajectory file.";
+        exit(1);
+      }
+      pid_t pid = fork();
+      if (pid < 0) {
+        _ERROR << "SUP:: failed to fork actor #" << k;
+        exit(1);
+      }
+      if (pid == 0) {
+        dynet::rndeng->seed(seed + k);
+        for (unsigned i = actors.begin + k; i < actors.end; i += n_actors) {
+          Trajectory trajectory;
+          rollout(corpus, order[i], iter, trajectory);
+          unsigned n_words = trajectory.wids.size();
+          unsigned len = trajectory.steps.size();
+          fwrite(&trajectory.sid, sizeof(unsigned), 1, fp);
+          fwrite(&n_words, sizeof(unsigned), 1, fp);
+          fwrite(trajectory.wids.data(), sizeof(unsigned), n_words, fp);
+          fwrite(&len, sizeof(unsigned), 1, fp);
+          fwrite(trajectory.steps.data(), sizeof(unsigned), len, fp);
+        }
+        fflush(fp);
+        _exit(ferror(fp) ? 1 : 0);
+      }
+      actors.pids.push_back(pid);
+      actors.files.push_back(fp);
+    }
+    return actors;
+  };
+
+  auto collect = [&](Actors & actors, std::vector<Trajectory> & trajectories) {
+    trajectories.clear();
+    for (unsigned k = 0; k < actors.pids.size(); ++k) {
+      int status = 0;
+      if (waitpid(actors.pids[k], &status, 0) != actors.pids[k] ||
+          !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        _ERROR << "SUP:: actor " << actors.pids[k] << " failed.";
+        exit(1);
+      }
+      FILE * fp = actors.files[k];
+      rewind(fp);
+      Trajectory trajectory;
+      unsigned n_words, len;
+      while (fread(&trajectory.sid, sizeof(unsigned), 1, fp) == 1 &&
+             fread(&n_words, sizeof(unsigned), 1, fp) == 1) {
+        trajectory.wids.resize(n_words);
+        if (fread(trajectory.wids.data(), sizeof(unsigned), n_words, fp) != n_words ||
+            fread(&len, sizeof(unsigned), 1, fp) != 1) { break; }
+        trajectory.steps.resize(len);
+        if (fread(trajectory.steps.data(), sizeof(unsigned), len, fp) != len) { break; }
+        trajectories.push_back(trajectory);
+      }
+      fclose(fp);
+    }
+  };
+
+  // the actors of the next chunk roll out while the learner consumes the
+  // trajectories of the current one.
+  std::vector<Trajectory> trajectories;
+  Actors current = launch(0);
+  while (current.begin < n) {
+    bool has_next = (current.end < n);
+    Actors next;
+    if (has_next) { next = launch(current.end); }
+    collect(current, trajectories);
+    for (const Trajectory & trajectory : trajectories) {
+      InputUnits & input_units = corpus.training_inputs[trajectory.sid];
+      // replay the noise the actor explored with rather than drawing anew.
+      for (unsigned i = 0; i < input_units.size(); ++i) { input_units[i].wid = trajectory.wids[i]; }
+      float lp = train_trajectory(input_units, trajectory.steps);
+      noisifier.denoisify(input_units);
+      step(trainer, input_units.size());
+      report_func(lp);
+    }
+    if (!has_next) { break; }
+    current = next;
+  }
+  flush(trainer);
+#endif
+}
+
+void SupervisedTrainer::rollout(Corpus & corpus,
+                                unsigned sid,
+                                unsigned iter,
+                                Trajectory & trajectory) {
+  TransitionSystem & system = state_builder.system;
+  InputUnits & input_units = corpus.training_inputs[sid];
+  const ParseUnits & parse_units = corpus.training_parses[sid];
+
+  std::vector<unsigned> ref_heads, ref_deprels;
+  parse_to_vector(parse_units, ref_heads, ref_deprels);
+
+  noisifier.noisify(input_units);
+  trajectory.wids.clear();
+  for (const InputUnit & u : input_units) { trajectory.wids.push_back(u.wid); }
+
+  ParserState * parser_state = state_builder.build();
+  dynet::ComputationGraph cg;
+  parser_state->new_graph(cg);
+  parser_state->initialize(cg, input_units);
+
+  unsigned len = input_units.size();
+  TransitionState transition_state(len);
+  transition_state.initialize(input_units);
+
+  unsigned illegal_action = system.num_actions();
+  trajectory.sid = sid;
+  trajectory.steps.clear();
+  while (!transition_state.terminated()) {
+    std::vector<unsigned> valid_actions;
+    system.get_valid_actions(transition_state, valid_actions);
+
+    unsigned best_gold_action = illegal_action;
+    unsigned worst_gold_action = illegal_action;
+    unsigned best_non_gold_action = illegal_action;
+    unsigned action = valid_actions[0];
+    // the oracle has no choice to make on a forced transition.
+    if (valid_actions.size() == 1) {
+      best_gold_action = worst_gold_action = action;
+    } else {
+      dynet::Expression score_exprs = parser_state->get_scores();
+      std::vector<float> scores = dynet::as_vector(cg.get_value(score_exprs));
+      action = explore(transition_state, valid_actions, scores, ref_heads, ref_deprels, iter,
+                       best_gold_action, worst_gold_action, best_non_gold_action);
+    }
+    trajectory.steps.push_back(action);
+    trajectory.steps.push_back(best_gold_action);
+    trajectory.steps.push_back(worst_gold_action);
+    trajectory.steps.push_back(best_non_gold_action);
+
+    system.perform_action(transition_state, action);
+    parser_state->perform_action(action, cg, transition_state);
+  }
+  delete parser_state;
+  noisifier.denoisify(input_units);
+}
+
+float SupervisedTrainer::train_trajectory(const InputUnits & input_units,
+                                          const std::vector<unsigned> & steps) {
+  TransitionSystem & system = state_builder.system;
+
+  stats.tick();
+  ParserState * parser_state = state_builder.build();
+  dynet::ComputationGraph cg;
+  parser_state->new_graph(cg);
+  parser_state->initialize(cg, input_units);
+
+  unsigned len = input_units.size();
+  TransitionState transition_state(len);
+  transition_state.initialize(input_units);
+
+  std::vector<dynet::Expression> loss;
+  std::vector<unsigned> valid_actions;
+  for (unsigned i = 0; i + 3 < steps.size(); i += 4) {
+    system.get_valid_actions(transition_state, valid_actions);
+    if (!forced_without_loss(valid_actions)) {
+      dynet::Expression score_exprs = parser_state->get_scores();
+      add_loss_one_step(score_exprs, steps[i + 1], steps[i + 2], steps[i + 3], loss);
+    }
+
+    system.perform_action(transition_state, steps[i]);
+    parser_state->perform_action(steps[i], cg, transition_state);
+  }
+  float ret = 0.;
+  if (loss.size() > 0) {
+    dynet::Expression l = regularizer.regularize(dynet::sum(loss), loss.size(), parser_state->get_params());
+    stats.tock(TrainStats::kConstruct);
+    ret = dynet::as_scalar(cg.incremental_forward(l));
+    stats.tock(TrainStats::kForward);
+    cg.backward(l);
+    stats.tock(TrainStats::kBackward);
+  }
+  stats.sample_memory();
+  stats.add_sentence(len, steps.size() / 4);
+  delete parser_state;
+  return ret;
+}
+
+unsigned SupervisedTrainer::explore(const TransitionState & transition_state,
+                                     const std::vector<unsigned> & valid_actions,
+                                     const std::vector<float> & scores,
+                                     const std::vector<unsigned> & ref_heads,
+                                     const std::vector<unsigned> & ref_deprels,
+                                     unsigned iter,
+                                     unsigned & best_gold_action,
+                                     unsigned & worst_gold_action,
+                                     unsigned & best_non_gold_action) {
+  TransitionSystem & system = state_builder.system;
+  auto payload = ParserState::get_best_action(scores, valid_actions);
+  unsigned action = payload.first;
+  std::vector<float> costs; // the larger, the better
+  {
+    TraceSpan span("get_transition_costs");
+    system.get_transition_costs(transition_state, valid_actions, ref_heads, ref_deprels, costs);
+  }
+  float gold_action_cost = (*std::max_element(costs.begin(), costs.end()));
+  float action_cost = 0.f;
+  float best_gold_action_score = -1e10, worst_gold_action_score = 1e10, best_non_gold_action_score = -1e10;
+  for (unsigned i = 0; i < valid_actions.size(); ++i) {
+    unsigned act = valid_actions[i];
+    float s = scores[act];
+    if (costs[i] == gold_action_cost) {
+      if (best_gold_action_score < s) { best_gold_action_score = s; best_gold_action = act; }
+      if (worst_gold_action_score > s) { worst_gold_action_score = s; worst_gold_action = act; }
+    } else {
+      if (best_non_gold_action_score < s) { best_non_gold_action_score = s; best_non_gold_action = act; }
+    }
+    if (act == action) { action_cost = costs[i]; }
+  }
+  if (gold_action_cost != action_cost) {
+    if (!(iter >= do_pretrain_iter && dynet::rand01() < do_explore_prob)) {
+      action = best_gold_action;
+    }
+  }
+  return action;
+}
+
 float SupervisedTrainer::train_full_tree(const InputUnits& input_units,
                                          const ParseUnits& parse_units,
-                                         dynet::Trainer* trainer,
                                          unsigned iter) {
   TransitionSystem & system = state_builder.system;
 
@@ -182,10 +798,16 @@ float SupervisedTrainer::train_full_tree(const InputUnits& input_units,
   std::vector<unsigned> gold_actions;
   system.get_oracle_actions(ref_heads, ref_deprels, gold_actions);
 
+  stats.tick();
+  Tracer::instance().next_sentence();
   ParserState * parser_state = state_builder.build();
   dynet::ComputationGraph cg;
   parser_state->new_graph(cg);
-  parser_state->initialize(cg, input_units);
+  {
+    TraceSpan span("initialize");
+    parser_state->initialize(cg, input_units);
+  }
+  stats.tock(TrainStats::kConstruct);
 
   unsigned len = input_units.size();
   TransitionState transition_state(len);
@@ -193,45 +815,48 @@ float SupervisedTrainer::train_full_tree(const InputUnits& input_units,
 
   unsigned illegal_action = system.num_actions();
   unsigned n_actions = 0;
+  // the static oracle with the crossentropy loss never reads the scores, the
+  // graph of the whole sentence is then only evaluated once with the loss.
+  bool need_scores = (oracle_type == kDynamic ||
+                      objective_type == kRank ||
+                      objective_type == kBipartieRank);
 
   std::vector<dynet::Expression> loss;
+  std::vector<float> scores;
   while (!transition_state.terminated()) {
     // collect all valid actions.
     std::vector<unsigned> valid_actions;
     system.get_valid_actions(transition_state, valid_actions);
+    bool forced = (valid_actions.size() == 1);
 
+    TraceSpan span("perform_action");
+    if (forced_without_loss(valid_actions)) {
+      system.perform_action(transition_state, valid_actions[0]);
+      parser_state->perform_action(valid_actions[0], cg, transition_state);
+      n_actions++;
+      continue;
+    }
+
+    span.next("get_scores");
     dynet::Expression score_exprs = parser_state->get_scores();
-    std::vector<float> scores = dynet::as_vector(cg.get_value(score_exprs));
+    stats.tock(TrainStats::kConstruct);
+    if (need_scores && !forced) {
+      span.next("get_value");
+      scores = dynet::as_vector(cg.get_value(score_exprs));
+      stats.tock(TrainStats::kForward);
+    }
+    span.next("oracle");
 
     unsigned action = 0;
     unsigned best_gold_action = illegal_action;
     unsigned worst_gold_action = illegal_action;
     unsigned best_non_gold_action = illegal_action;
 
-    if (oracle_type == kDynamic) {
-      auto payload = ParserState::get_best_action(scores, valid_actions);
-      action = payload.first;
-      std::vector<float> costs; // the larger, the better
-      system.get_transition_costs(transition_state, valid_actions, ref_heads, ref_deprels, costs);
-      float gold_action_cost = (*std::max_element(costs.begin(), costs.end()));
-      float action_cost = 0.f;
-      float best_gold_action_score = -1e10, worst_gold_action_score = 1e10, best_non_gold_action_score = -1e10;
-      for (unsigned i = 0; i < valid_actions.size(); ++i) {
-        unsigned act = valid_actions[i];
-        float s = scores[act];
-        if (costs[i] == gold_action_cost) {
-          if (best_gold_action_score < s) { best_gold_action_score = s; best_gold_action = act; }
-          if (worst_gold_action_score > s) { worst_gold_action_score = s; worst_gold_action = act; }
-        } else {
-          if (best_non_gold_action_score < s) { best_non_gold_action_score = s; best_non_gold_action = act; }
-        }
-        if (act == action) { action_cost = costs[i]; }
-      }
-      if (gold_action_cost != action_cost) {
-        if (!(iter >= do_pretrain_iter && dynet::rand01() < do_explore_prob)) {
-          action = best_gold_action;
-        }
-      }
+    if (forced) {
+      action = best_gold_action = worst_gold_action = valid_actions[0];
+    } else if (oracle_type == kDynamic) {
+      action = explore(transition_state, valid_actions, scores, ref_heads, ref_deprels, iter,
+                       best_gold_action, worst_gold_action, best_non_gold_action);
     } else {
       best_gold_action = gold_actions[n_actions];
       action = gold_actions[n_actions];
@@ -247,44 +872,54 @@ float SupervisedTrainer::train_full_tree(const InputUnits& input_units,
       }
     }
     
+    stats.tock(TrainStats::kOracle);
     add_loss_one_step(score_exprs, best_gold_action, worst_gold_action, best_non_gold_action, loss);
 
+    span.next("perform_action");
     system.perform_action(transition_state, action);
     parser_state->perform_action(action, cg, transition_state);
     n_actions++;
   }
   float ret = 0.;
   if (loss.size() > 0) {
-    std::vector<dynet::Expression> all_params = parser_state->get_params();
-    std::vector<dynet::Expression> reg;
-    for (auto e : all_params) { reg.push_back(dynet::squared_norm(e)); }
-    dynet::Expression l = dynet::sum(loss) + 0.5 * loss.size() * lambda_ * dynet::sum(reg);
+    dynet::Expression l = regularizer.regularize(dynet::sum(loss), loss.size(), parser_state->get_params());
+    stats.tock(TrainStats::kConstruct);
     ret = dynet::as_scalar(cg.incremental_forward(l));
-    cg.backward(l);
-    trainer->update();
+    stats.tock(TrainStats::kForward);
+    {
+      TraceSpan span("backward");
+      cg.backward(l);
+    }
+    stats.tock(TrainStats::kBackward);
   }
+  stats.sample_memory();
+  stats.add_sentence(len, n_actions);
   delete parser_state;
   return ret;
 }
 
 float SupervisedTrainer::train_structure_full_tree(const InputUnits & input_units,
                                                    const ParseUnits & parse_units,
-                                                   dynet::Trainer * trainer,
                                                    unsigned beam_size,
                                                    unsigned iter) {
-  typedef std::tuple<unsigned, unsigned, float, dynet::Expression> Transition;
+  typedef std::tuple<unsigned, unsigned, float> Transition;
   TransitionSystem & system = state_builder.system;
 
   std::vector<unsigned> ref_heads, ref_deprels, gold_actions;
   parse_to_vector(parse_units, ref_heads, ref_deprels);
   system.get_oracle_actions(ref_heads, ref_deprels, gold_actions);
 
+  // only the current beam is kept, the items that fell off the beam are
+  // released at every step.
   unsigned len = input_units.size();
-  std::vector<TransitionState> transition_states;
-  std::vector<float> scores;
-  std::vector<dynet::Expression> scores_exprs;
-  std::vector<ParserState *> parser_states;
+  std::vector<TransitionState> transition_states, new_transition_states;
+  std::vector<float> scores, new_scores;
+  std::vector<dynet::Expression> scores_exprs, new_scores_exprs;
+  std::vector<ParserState *> parser_states, new_parser_states;
+  std::vector<dynet::Expression> transit_scores_exprs;
 
+  stats.tick();
+  Tracer::instance().next_sentence();
   dynet::ComputationGraph cg;
 
   transition_states.push_back(TransitionState(len));
@@ -292,117 +927,115 @@ float SupervisedTrainer::train_structure_full_tree(const InputUnits & input_unit
 
   parser_states.push_back(state_builder.build());
   parser_states[0]->new_graph(cg);
-  parser_states[0]->initialize(cg, input_units);
+  {
+    TraceSpan span("initialize");
+    parser_states[0]->initialize(cg, input_units);
+  }
+  stats.tock(TrainStats::kConstruct);
 
   scores.push_back(0.);
   scores_exprs.push_back(dynet::zeroes(cg, { 1 }));
 
-  unsigned curr = 0, next = 1, corr = 0;
+  // the graph node of a transition is only created if it enters the beam.
+  auto extend = [&](const Transition & transition) {
+    unsigned cursor = std::get<0>(transition);
+    unsigned action = std::get<1>(transition);
+    TransitionState new_transition_state(transition_states[cursor]);
+    ParserState * new_parser_state = parser_states[cursor]->copy();
+    dynet::Expression new_score_expr = scores_exprs[cursor];
+    if (action != system.num_actions()) {
+      new_score_expr = new_score_expr + dynet::pick(transit_scores_exprs[cursor], action);
+      system.perform_action(new_transition_state, action);
+      new_parser_state->perform_action(action, cg, new_transition_state);
+    }
+    new_transition_states.push_back(new_transition_state);
+    new_scores.push_back(std::get<2>(transition));
+    new_scores_exprs.push_back(new_score_expr);
+    new_parser_states.push_back(new_parser_state);
+  };
+
+  unsigned corr = 0;
   unsigned n_step = 0;
+  std::vector<Transition> transitions;
   while (!transition_states[corr].terminated()) {
     unsigned gold_action = gold_actions[n_step];
     n_step++;
 
-    std::vector<Transition> transitions;
-    for (unsigned i = curr; i < next; ++i) {
+    transitions.clear();
+    transit_scores_exprs.resize(transition_states.size());
+    for (unsigned i = 0; i < transition_states.size(); ++i) {
       const TransitionState & prev_state = transition_states[i];
       float prev_score = scores[i];
-      dynet::Expression prev_score_expr = scores_exprs[i];
 
       if (prev_state.terminated()) {
-        transitions.push_back(std::make_tuple(i, system.num_actions(), prev_score, prev_score_expr));
+        transitions.push_back(std::make_tuple(i, system.num_actions(), prev_score));
       } else {
         ParserState * parser_state = parser_states[i];
         std::vector<unsigned> valid_actions;
         system.get_valid_actions(prev_state, valid_actions);
 
-        dynet::Expression transit_scores_expr = parser_state->get_scores();
-        std::vector<float> transit_scores = dynet::as_vector(cg.get_value(transit_scores_expr));
+        TraceSpan span("get_scores");
+        transit_scores_exprs[i] = parser_state->get_scores();
+        stats.tock(TrainStats::kConstruct);
+        span.next("get_value");
+        std::vector<float> transit_scores = dynet::as_vector(cg.get_value(transit_scores_exprs[i]));
+        stats.tock(TrainStats::kForward);
         for (unsigned a : valid_actions) {
-          transitions.push_back(std::make_tuple(
-            i, a, prev_score + transit_scores[a],
-            prev_score_expr + dynet::pick(transit_scores_expr, a)
-          ));
+          transitions.push_back(std::make_tuple(i, a, prev_score + transit_scores[a]));
         }
       }
     }
 
-    sort(transitions.begin(), transitions.end(),
-         [](const Transition& a, const Transition& b) { return std::get<2>(a) > std::get<2>(b); });
-
-    unsigned new_corr = UINT_MAX, new_curr = next, new_next = next;
-    for (unsigned i = 0; i < transitions.size() && i < beam_size; ++i) {
-      unsigned cursor = std::get<0>(transitions[i]);
-      unsigned action = std::get<1>(transitions[i]);
-      float new_score = std::get<2>(transitions[i]);
-      dynet::Expression new_score_expr = std::get<3>(transitions[i]);
-      TransitionState & transition_state = transition_states[cursor];
-      TransitionState new_transition_state(transition_state);
-      ParserState * parser_state = parser_states[cursor];
-      ParserState * new_parser_state = parser_state->copy();
-      if (action != system.num_actions()) {
-        system.perform_action(new_transition_state, action);
-        new_parser_state->perform_action(action, cg, new_transition_state);
-      }
-
-      //      
-      transition_states.push_back(new_transition_state);
-      scores.push_back(new_score);
-      scores_exprs.push_back(new_score_expr);
-      parser_states.push_back(new_parser_state);
+    unsigned n_kept = std::min<unsigned>(transitions.size(), beam_size);
+    std::partial_sort(transitions.begin(), transitions.begin() + n_kept, transitions.end(),
+                      [](const Transition& a, const Transition& b) { return std::get<2>(a) > std::get<2>(b); });
 
-      if (cursor == corr && action == gold_action) { new_corr = new_next; }
-      new_next++;
+    unsigned new_corr = UINT_MAX;
+    for (unsigned i = 0; i < n_kept; ++i) {
+      if (std::get<0>(transitions[i]) == corr && std::get<1>(transitions[i]) == gold_action) {
+        new_corr = new_transition_states.size();
+      }
+      extend(transitions[i]);
     }
     bool early_update = (new_corr == UINT_MAX);
 
     if (early_update) {
-      // early stopping
-      for (unsigned i = beam_size; i < transitions.size(); ++i) {
-        unsigned cursor = std::get<0>(transitions[i]);
-        unsigned action = std::get<1>(transitions[i]);
-        float new_score = std::get<2>(transitions[i]);
-        if (cursor == corr && action == gold_action) {
-          dynet::Expression new_score_expr = std::get<3>(transitions[i]);
-          TransitionState & transition_state = transition_states[cursor];
-          TransitionState new_transition_state(transition_state);
-          ParserState * parser_state = parser_states[cursor];
-          ParserState * new_parser_state = parser_state->copy();
-          if (action != system.num_actions()) {
-            system.perform_action(new_transition_state, action);
-            new_parser_state->perform_action(action, cg, new_transition_state);
-          }
-          //      
-          transition_states.push_back(new_transition_state);
-          scores.push_back(new_score);
-          scores_exprs.push_back(new_score_expr);
-          parser_states.push_back(new_parser_state);
-          new_corr = new_next;
-          new_next++;
+      // early stopping, the gold transition joins the beam for the loss.
+      for (unsigned i = n_kept; i < transitions.size(); ++i) {
+        if (std::get<0>(transitions[i]) == corr && std::get<1>(transitions[i]) == gold_action) {
+          new_corr = new_transition_states.size();
+          extend(transitions[i]);
           break;
         }
       }
     }
 
+    for (ParserState * parser_state : parser_states) { delete parser_state; }
+    transition_states.swap(new_transition_states);
+    scores.swap(new_scores);
+    scores_exprs.swap(new_scores_exprs);
+    parser_states.swap(new_parser_states);
+    new_transition_states.clear();
+    new_scores.clear();
+    new_scores_exprs.clear();
+    new_parser_states.clear();
     corr = new_corr;
-    curr = new_curr;
-    next = new_next;
 
     if (early_update) { break; }
   }
 
-  std::vector<dynet::Expression> loss;
-  for (unsigned i = curr; i < next; ++i) {
-    loss.push_back(scores_exprs[i]);
-  }
-  std::vector<dynet::Expression> all_params = parser_states[0]->get_params();
-  std::vector<dynet::Expression> reg;
-  for (auto e : all_params) { reg.push_back(dynet::squared_norm(e)); }
-  dynet::Expression l =
-    dynet::pickneglogsoftmax(dynet::concatenate(loss), corr - curr) + 0.5 * lambda_ * dynet::sum(reg);
+  dynet::Expression l = regularizer.regularize(
+    dynet::pickneglogsoftmax(dynet::concatenate(scores_exprs), corr), 1.f, parser_states[0]->get_params());
+  stats.tock(TrainStats::kConstruct);
   float ret = dynet::as_scalar(cg.incremental_forward(l));
-  cg.backward(l);
-  trainer->update();
+  stats.tock(TrainStats::kForward);
+  {
+    TraceSpan span("backward");
+    cg.backward(l);
+  }
+  stats.tock(TrainStats::kBackward);
+  stats.sample_memory();
+  stats.add_sentence(len, n_step);
 
   for (ParserState * parser_state : parser_states) { delete parser_state; }
   return ret;
@@ -410,17 +1043,22 @@ float SupervisedTrainer::train_structure_full_tree(const InputUnits & input_unit
 
 float SupervisedTrainer::train_partial_tree(const InputUnits& input_units,
                                             const ParseUnits& parse_units,
-                                            dynet::Trainer* trainer,
                                             unsigned iter) {
   TransitionSystem & system = state_builder.system;
   
   std::vector<unsigned> ref_heads, ref_deprels;
   parse_to_vector(parse_units, ref_heads, ref_deprels);
 
+  stats.tick();
+  Tracer::instance().next_sentence();
   ParserState * parser_state = state_builder.build();
   dynet::ComputationGraph cg;
   parser_state->new_graph(cg);
-  parser_state->initialize(cg, input_units);
+  {
+    TraceSpan span("initialize");
+    parser_state->initialize(cg, input_units);
+  }
+  stats.tock(TrainStats::kConstruct);
 
   unsigned len = input_units.size();
   TransitionState transition_state(len);
@@ -435,8 +1073,21 @@ float SupervisedTrainer::train_partial_tree(const InputUnits& input_units,
     std::vector<unsigned> valid_actions;
     system.get_valid_actions(transition_state, valid_actions);
 
+    TraceSpan span("perform_action");
+    if (forced_without_loss(valid_actions)) {
+      system.perform_action(transition_state, valid_actions[0]);
+      parser_state->perform_action(valid_actions[0], cg, transition_state);
+      n_actions++;
+      continue;
+    }
+
+    span.next("get_scores");
     dynet::Expression score_exprs = parser_state->get_scores();
+    stats.tock(TrainStats::kConstruct);
+    span.next("get_value");
     std::vector<float> scores = dynet::as_vector(cg.get_value(score_exprs));
+    stats.tock(TrainStats::kForward);
+    span.next("oracle");
 
     unsigned action = 0;
     unsigned best_gold_action = illegal_action;
@@ -466,8 +1117,10 @@ float SupervisedTrainer::train_partial_tree(const InputUnits& input_units,
       action = best_gold_action;
     }
 
+    stats.tock(TrainStats::kOracle);
     add_loss_one_step(score_exprs, best_gold_action, worst_gold_action, best_non_gold_action, loss);
 
+    span.next("perform_action");
     system.perform_action(transition_state, action);
     parser_state->perform_action(action, cg, transition_state);
     n_actions++;
@@ -475,14 +1128,18 @@ float SupervisedTrainer::train_partial_tree(const InputUnits& input_units,
 
   float ret = 0.f;
   if (loss.size() > 0) {
-    std::vector<dynet::Expression> all_params = parser_state->get_params();
-    std::vector<dynet::Expression> reg;
-    for (auto e : all_params) { reg.push_back(dynet::squared_norm(e)); }
-    dynet::Expression l = dynet::sum(loss) + 0.5 * loss.size() * lambda_ * dynet::sum(reg);
+    dynet::Expression l = regularizer.regularize(dynet::sum(loss), loss.size(), parser_state->get_params());
+    stats.tock(TrainStats::kConstruct);
     ret = dynet::as_scalar(cg.incremental_forward(l));
-    cg.backward(l);
-    trainer->update();
+    stats.tock(TrainStats::kForward);
+    {
+      TraceSpan span("backward");
+      cg.backward(l);
+    }
+    stats.tock(TrainStats::kBackward);
   }
+  stats.sample_memory();
+  stats.add_sentence(len, n_actions);
   delete parser_state;
   return ret;
 }
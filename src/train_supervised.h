@@ -3,13 +3,19 @@
 
 #include <iostream>
 #include <set>
+#include <functional>
 #include <boost/program_options.hpp>
 #include "dynet/training.h"
 #include "parser_builder.h"
 #include "noisify.h"
+#include "trainer_utils.h"
+#include "grad_allreduce.h"
+#include "train_stats.h"
 
 namespace po = boost::program_options;
 
+struct Trajectory;
+
 struct SupervisedTrainer {
   enum ORACLE_TYPE { kStatic, kDynamic };
   enum OBJECTIVE_TYPE { kCrossEntropy, kRank, kBipartieRank, kStructure };
@@ -17,9 +23,21 @@ struct SupervisedTrainer {
   OBJECTIVE_TYPE objective_type;
   ParserStateBuilder & state_builder;
   const Noisifier& noisifier;
-  float lambda_;
+  L2Regularizer regularizer;
   float do_pretrain_iter;
   float do_explore_prob;
+  unsigned batch_size;
+  unsigned batch_tokens;
+  unsigned n_batch_sents;
+  unsigned n_batch_tokens;
+  unsigned bucket_width;
+  unsigned n_workers;
+  bool deterministic;
+  unsigned n_replicas;
+  unsigned n_actors;
+  unsigned actor_refresh;
+  bool drop_forced;
+  TrainStats stats;
 
   static po::options_description get_options();
 
@@ -35,22 +53,71 @@ struct SupervisedTrainer {
              bool allow_nonprojective,
              bool allow_partial_tree);
 
+  /* The train_* functions only accumulate the gradient of one sentence,
+     the parameters are updated by step() once the batch is full. */
   float train_full_tree(const InputUnits& input_units,
                         const ParseUnits& parse_units,
-                        dynet::Trainer* trainer, 
                         unsigned iter);
 
   float train_structure_full_tree(const InputUnits & input_units,
                                   const ParseUnits & parse_units,
-                                  dynet::Trainer * trainer,
                                   unsigned beam_size,
                                   unsigned iter);
 
   float train_partial_tree(const InputUnits& input_units,
                            const ParseUnits& parse_units,
-                           dynet::Trainer* trainer,
                            unsigned iter);
 
+  /* Train one iteration with multiple forked workers that share the parameters. */
+  void train_workers(Corpus & corpus,
+                     const std::vector<unsigned> & order,
+                     dynet::Trainer * trainer,
+                     const std::function<float(unsigned)> & train_func,
+                     const std::function<void(float)> & report_func);
+
+  /* Train one iteration as one of the synchronous replicas, the gradients of
+     each batch are summed over the replicas before the update. */
+  void train_replicas(Corpus & corpus,
+                      const std::vector<unsigned> & order,
+                      dynet::Trainer * trainer,
+                      GradientAllReducer * reducer,
+                      unsigned rank,
+                      const std::function<float(unsigned)> & train_func,
+                      const std::function<void(float)> & report_func);
+
+  /* Train one iteration with the dynamic oracle, the exploring rollouts and
+     the cost computation are done by forked actors on a snapshot of the
+     parameters, while the learner replays their trajectories. */
+  void train_actor_learner(Corpus & corpus,
+                           const std::vector<unsigned> & order,
+                           dynet::Trainer * trainer,
+                           unsigned iter,
+                           const std::function<void(float)> & report_func);
+
+  void rollout(Corpus & corpus, unsigned sid, unsigned iter, Trajectory & trajectory);
+
+  float train_trajectory(const InputUnits & input_units,
+                         const std::vector<unsigned> & steps);
+
+  /* Choose the next action with the dynamic oracle, return the action to perform. */
+  unsigned explore(const TransitionState & transition_state,
+                   const std::vector<unsigned> & valid_actions,
+                   const std::vector<float> & scores,
+                   const std::vector<unsigned> & ref_heads,
+                   const std::vector<unsigned> & ref_deprels,
+                   unsigned iter,
+                   unsigned & best_gold_action,
+                   unsigned & worst_gold_action,
+                   unsigned & best_non_gold_action);
+
+  /* A transition with a single valid action is performed without scoring if
+     it adds nothing to the loss. */
+  bool forced_without_loss(const std::vector<unsigned> & valid_actions) const;
+
+  void step(dynet::Trainer * trainer, unsigned n_tokens);
+
+  void flush(dynet::Trainer * trainer);
+
   void add_loss_one_step(dynet::Expression & score_expr,
                          const unsigned & best_gold_action,
                          const unsigned & worst_gold_action,
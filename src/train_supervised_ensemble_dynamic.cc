@@ -3,6 +3,8 @@
 #include "tree.h"
 #include "logging.h"
 #include "evaluate.h"
+#include "async_evaluator.h"
+#include "trace.h"
 #include "math_utils.h"
 
 po::options_description SupervisedEnsembleDynamicTrainer::get_options() {
@@ -13,6 +15,7 @@ po::options_description SupervisedEnsembleDynamicTrainer::get_options() {
     ("dynamic_ensemble_objective", po::value<std::string>()->default_value("crossentropy"), "The learning objective [crossentropy|sparse_crossentropy]")
     ("dynamic_ensemble_egreedy_epsilon", po::value<float>()->default_value(0.1f), "The epsilon for epsilon-greedy policy.")
     ("dynamic_ensemble_boltzmann_temperature", po::value<float>()->default_value(1.f), "The epsilon for epsilon-greedy policy.")
+    ("supervised_drop_forced", "Leave the transitions with a single valid action out of the loss, they are performed without scoring.")
     ;
   return cmd;
 }
@@ -24,9 +27,8 @@ SupervisedEnsembleDynamicTrainer::SupervisedEnsembleDynamicTrainer(const po::var
   state_builder(state_builder),
   pretrained_state_builders(pretrained_state_builders),
   noisifier(noisifier),
+  regularizer(conf, state_builder.model, "ENS_DYN"),
   n_pretrained(pretrained_state_builders.size()) {
-  lambda_ = conf["lambda"].as<float>();
-  _INFO << "ENS_DYN:: lambda = " << lambda_;
 
   std::string ensemble_method_name = conf["static_ensemble_method"].as<std::string>();
   if (ensemble_method_name == "prob") {
@@ -57,6 +59,10 @@ SupervisedEnsembleDynamicTrainer::SupervisedEnsembleDynamicTrainer(const po::var
     exit(1);
   }                                                                       
   _INFO << "ENS_DYN:: learning objective " << objective_name;
+  drop_forced = (conf.count("supervised_drop_forced") > 0);
+  if (drop_forced) {
+    _INFO << "ENS_DYN:: forced transitions are left out of the loss.";
+  }
   
   if (rollin_type == kEpsilonGreedy) {
     epsilon = conf["dynamic_ensemble_egreedy_epsilon"].as<float>();
@@ -90,6 +96,15 @@ void SupervisedEnsembleDynamicTrainer::train(const po::variables_map& conf,
   unsigned evaluate_stops = conf["evaluate_stops"].as<unsigned>();
   unsigned evaluate_skips = conf["evaluate_skips"].as<unsigned>();
 
+  AsyncEvaluator evaluator(conf, model, name);
+  auto evaluate_func = [&]() -> float { return evaluate(conf, corpus, state_builder, output); };
+  auto on_evaluated = [&best_f](float f) -> bool {
+    if (f <= best_f) { return false; }
+    best_f = f;
+    _INFO << "ENS_DYN:: new best record achieved: " << best_f << ", saved.";
+    return true;
+  };
+
   _INFO << "ENS_DYN:: will stop after " << max_iter << " iterations.";
   for (unsigned iter = 0; iter < max_iter; ++iter) {
     llh = 0;
@@ -111,27 +126,29 @@ void SupervisedEnsembleDynamicTrainer::train(const po::variables_map& conf,
       if (logc % report_stops == 0) {
         float epoch = (float(logc) / n_train);
         _INFO << "ENS_DYN:: iter #" << iter << " (epoch " << epoch << ") loss " << llh_in_batch;
+        _INFO << "ENS_DYN:: " << stats.report();
         llh_in_batch = 0.f;
+        stats.reset();
       }
       if (iter >= evaluate_skips && logc % evaluate_stops == 0) {
-        float f = evaluate(conf, corpus, state_builder, output);
-        if (f > best_f) {
-          best_f = f;
-          _INFO << "ENS_DYN:: new best record achieved: " << best_f << ", saved.";
-          dynet::save_dynet_model(name, (&model));
-        }
+        regularizer.flush();
+        stats.tick();
+        evaluator.evaluate(evaluate_func, on_evaluated);
+        stats.tock(TrainStats::kEvaluate);
       }
+      evaluator.poll();
     }
 
     _INFO << "ENS_DYN:: end of iter #" << iter << " loss " << llh;
-    float f = evaluate(conf, corpus, state_builder, output);
-    if (f > best_f) {
-      best_f = f;
-      _INFO << "ENS_DYN:: new best record achieved: " << best_f << ", saved.";
-      dynet::save_dynet_model(name, (&model));
-    }
+    _INFO << "ENS_DYN:: arena high-water " << stats.high_water.to_json();
+    stats.high_water.clear();
+    regularizer.flush();
+    stats.tick();
+    evaluator.evaluate(evaluate_func, on_evaluated);
+    stats.tock(TrainStats::kEvaluate);
     update_trainer(conf, eta0, static_cast<float>(iter) + 1.f, trainer);
   }
+  evaluator.wait();
 
   delete trainer;
 }
@@ -165,21 +182,26 @@ float SupervisedEnsembleDynamicTrainer::train_full_tree(const InputUnits& input_
     system.get_oracle_actions(ref_heads, ref_deprels, gold_actions);
   }
 
+  stats.tick();
+  Tracer::instance().next_sentence();
   ParserState * parser_state = state_builder.build();
   dynet::ComputationGraph cg;
   parser_state->new_graph(cg);
-  parser_state->initialize(cg, input_units);
-
   std::vector<ParserState*> ensembled_parser_states(n_pretrained);
-  for (unsigned i = 0; i < n_pretrained; ++i) {
-    ensembled_parser_states[i] = pretrained_state_builders[i]->build();
-    ensembled_parser_states[i]->new_graph(cg);
-    ensembled_parser_states[i]->initialize(cg, input_units);
+  {
+    TraceSpan span("initialize");
+    parser_state->initialize(cg, input_units);
+    for (unsigned i = 0; i < n_pretrained; ++i) {
+      ensembled_parser_states[i] = pretrained_state_builders[i]->build();
+      ensembled_parser_states[i]->new_graph(cg);
+      ensembled_parser_states[i]->initialize(cg, input_units);
+    }
   }
 
   unsigned len = input_units.size();
   TransitionState transition_state(len);
   transition_state.initialize(input_units);
+  stats.tock(TrainStats::kConstruct);
 
   unsigned n_actions = 0;
   std::vector<dynet::Expression> loss;
@@ -187,9 +209,23 @@ float SupervisedEnsembleDynamicTrainer::train_full_tree(const InputUnits& input_
     // collect all valid actions.
     std::vector<unsigned> valid_actions;
     system.get_valid_actions(transition_state, valid_actions);
+    TraceSpan span("perform_action");
+    if (drop_forced && valid_actions.size() == 1) {
+      unsigned action = valid_actions[0];
+      system.perform_action(transition_state, action);
+      parser_state->perform_action(action, cg, transition_state);
+      for (ParserState * ensembled_parser_state : ensembled_parser_states) {
+        ensembled_parser_state->perform_action(action, cg, transition_state);
+      }
+      n_actions++;
+      continue;
+    }
 
+    span.next("get_scores");
     dynet::Expression score_exprs = parser_state->get_scores();
+    stats.tock(TrainStats::kConstruct);
     std::vector<float> scores = dynet::as_vector(cg.get_value(score_exprs));
+    stats.tock(TrainStats::kForward);
 
     std::vector<float> ensembled_scores(scores.size(), 0.f);
     for (ParserState* ensembled_parser_state : ensembled_parser_states) {
@@ -208,8 +244,11 @@ float SupervisedEnsembleDynamicTrainer::train_full_tree(const InputUnits& input_
     if (ensemble_method == kLogitsMean || ensemble_method == kLogitsSum) {
       softmax_inplace(ensembled_scores);
     }
+    // scoring with the pretrained models is the oracle of distillation.
+    stats.tock(TrainStats::kOracle);
     add_loss_one_step(score_exprs, valid_actions, ensembled_scores, loss);
 
+    span.next("perform_action");
     unsigned action = UINT_MAX;
     if (rollin_type == kExpert) {
       action = gold_actions[n_actions];
@@ -231,14 +270,24 @@ float SupervisedEnsembleDynamicTrainer::train_full_tree(const InputUnits& input_
   }
   float ret = 0.;
   if (loss.size() > 0) {
-    std::vector<dynet::Expression> all_params = parser_state->get_params();
-    std::vector<dynet::Expression> reg;
-    for (auto e : all_params) { reg.push_back(dynet::squared_norm(e)); }
-    dynet::Expression l = dynet::sum(loss) + 0.5 * loss.size() * lambda_ * dynet::sum(reg);
+    dynet::Expression l = regularizer.regularize(dynet::sum(loss), loss.size(), parser_state->get_params());
+    stats.tock(TrainStats::kConstruct);
     ret = dynet::as_scalar(cg.incremental_forward(l));
-    cg.backward(l);
-    trainer->update();
+    stats.tock(TrainStats::kForward);
+    {
+      TraceSpan span("backward");
+      cg.backward(l);
+    }
+    stats.tock(TrainStats::kBackward);
+    {
+      TraceSpan span("update");
+      trainer->update();
+      regularizer.update(trainer->learning_rate);
+    }
+    stats.tock(TrainStats::kUpdate);
   }
+  stats.sample_memory();
+  stats.add_sentence(len, n_actions);
   delete parser_state;
   for (ParserState * parser_state : ensembled_parser_states) { delete parser_state; }
   return ret;
@@ -7,6 +7,8 @@
 #include "dynet/training.h"
 #include "parser_builder.h"
 #include "noisify.h"
+#include "trainer_utils.h"
+#include "train_stats.h"
 
 namespace po = boost::program_options;
 
@@ -20,10 +22,12 @@ struct SupervisedEnsembleDynamicTrainer {
   ParserStateBuilder & state_builder;
   std::vector<ParserStateBuilder *>& pretrained_state_builders;
   const Noisifier& noisifier;
-  float lambda_;
+  L2Regularizer regularizer;
   float epsilon;
   float temperature;
   unsigned n_pretrained;
+  bool drop_forced;
+  TrainStats stats;
 
   static po::options_description get_options();
 
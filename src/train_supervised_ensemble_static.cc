@@ -4,15 +4,20 @@
 #include "logging.h"
 #include "tree.h"
 #include "evaluate.h"
+#include "async_evaluator.h"
+#include "trace.h"
 #include <random>
 
 SupervisedEnsembleStaticTrainer::SupervisedEnsembleStaticTrainer(const po::variables_map & conf,
                                                                  const Noisifier & noisifier, 
                                                                  ParserStateBuilder & state_builder) : 
   state_builder(state_builder),
-  noisifier(noisifier) {
-  lambda_ = conf["lambda"].as<float>();
-  _INFO << "ENS_STAT:: lambda = " << lambda_;
+  noisifier(noisifier),
+  regularizer(conf, state_builder.model, "ENS_STAT") {
+  drop_forced = (conf.count("supervised_drop_forced") > 0);
+  if (drop_forced) {
+    _INFO << "ENS_STAT:: forced transitions are left out of the loss.";
+  }
 }
 
 void SupervisedEnsembleStaticTrainer::train(const po::variables_map & conf, 
@@ -44,6 +49,15 @@ void SupervisedEnsembleStaticTrainer::train(const po::variables_map & conf,
   unsigned evaluate_stops = conf["evaluate_stops"].as<unsigned>();
   unsigned evaluate_skips = conf["evaluate_skips"].as<unsigned>();
 
+  AsyncEvaluator evaluator(conf, model, name);
+  auto evaluate_func = [&]() -> float { return evaluate(conf, corpus, state_builder, output); };
+  auto on_evaluated = [&best_f](float f) -> bool {
+    if (f <= best_f) { return false; }
+    best_f = f;
+    _INFO << "ENS_STAT:: new best record achieved: " << best_f << ", saved.";
+    return true;
+  };
+
   _INFO << "ENS_STAT:: will stop after " << max_iter << " iterations.";
   for (unsigned iter = 0; iter < max_iter; ++iter) {
     llh = 0;
@@ -67,27 +81,29 @@ void SupervisedEnsembleStaticTrainer::train(const po::variables_map & conf,
       if (logc % report_stops == 0) {
         float epoch = (float(logc) / n_train);
         _INFO << "ENS_STAT:: iter #" << iter << " (epoch " << epoch << ") loss " << llh_in_batch;
+        _INFO << "ENS_STAT:: " << stats.report();
         llh_in_batch = 0.f;
+        stats.reset();
       }
       if (iter >= evaluate_skips && logc % evaluate_stops == 0) {
-        float f = evaluate(conf, corpus, state_builder, output);
-        if (f > best_f) {
-          best_f = f;
-          _INFO << "ENS_STAT:: new best record achieved: " << best_f << ", saved.";
-          dynet::save_dynet_model(name, (&model));
-        }
+        regularizer.flush();
+        stats.tick();
+        evaluator.evaluate(evaluate_func, on_evaluated);
+        stats.tock(TrainStats::kEvaluate);
       }
+      evaluator.poll();
     }
 
     _INFO << "ENS_STAT:: end of iter #" << iter << " loss " << llh;
-    float f = evaluate(conf, corpus, state_builder, output);
-    if (f > best_f) {
-      best_f = f;
-      _INFO << "ENS_STAT:: new best record achieved: " << best_f << ", saved.";
-      dynet::save_dynet_model(name, (&model));
-    }
+    _INFO << "ENS_STAT:: arena high-water " << stats.high_water.to_json();
+    stats.high_water.clear();
+    regularizer.flush();
+    stats.tick();
+    evaluator.evaluate(evaluate_func, on_evaluated);
+    stats.tock(TrainStats::kEvaluate);
     update_trainer(conf, eta0, static_cast<float>(iter), trainer);
   }
+  evaluator.wait();
   delete trainer;
 }
 
@@ -100,14 +116,20 @@ float SupervisedEnsembleStaticTrainer::train_full_tree(const InputUnits & input_
   for (auto & payload : action_units.actions) {
     ref_actions.push_back(payload.action);
   }
+  stats.tick();
+  Tracer::instance().next_sentence();
   ParserState * parser_state = state_builder.build();
   dynet::ComputationGraph cg;
   parser_state->new_graph(cg);
-  parser_state->initialize(cg, input_units);
+  {
+    TraceSpan span("initialize");
+    parser_state->initialize(cg, input_units);
+  }
 
   unsigned len = input_units.size();
   TransitionState transition_state(len);
   transition_state.initialize(input_units);
+  stats.tock(TrainStats::kConstruct);
 
   unsigned n_actions = 0;
   std::vector<dynet::Expression> loss;
@@ -116,11 +138,15 @@ float SupervisedEnsembleStaticTrainer::train_full_tree(const InputUnits & input_
     std::vector<unsigned> valid_actions;
     system.get_valid_actions(transition_state, valid_actions);
 
-    dynet::Expression score_exprs = parser_state->get_scores();
-    std::vector<float> scores = dynet::as_vector(cg.get_value(score_exprs));
+    TraceSpan span("perform_action");
+    // the actions are given, the scores are only evaluated with the loss.
+    if (!drop_forced || valid_actions.size() > 1) {
+      dynet::Expression score_exprs = parser_state->get_scores();
+      stats.tock(TrainStats::kConstruct);
 
-    add_loss_one_step(score_exprs, valid_actions, action_units.actions[n_actions].prob,
-                      loss);
+      add_loss_one_step(score_exprs, valid_actions, action_units.actions[n_actions].prob,
+                        loss);
+    }
 
     unsigned action = action_units.actions[n_actions].action;
     system.perform_action(transition_state, action);
@@ -129,14 +155,24 @@ float SupervisedEnsembleStaticTrainer::train_full_tree(const InputUnits & input_
   }
   float ret = 0.f;
   if (!loss.empty()) {
-    std::vector<dynet::Expression> all_params = parser_state->get_params();
-    std::vector<dynet::Expression> reg;
-    for (auto e : all_params) { reg.push_back(dynet::squared_norm(e)); }
-    dynet::Expression l = dynet::sum(loss) + 0.5 * loss.size() * lambda_ * dynet::sum(reg);
+    dynet::Expression l = regularizer.regularize(dynet::sum(loss), loss.size(), parser_state->get_params());
+    stats.tock(TrainStats::kConstruct);
     ret = dynet::as_scalar(cg.incremental_forward(l));
-    cg.backward(l);
-    trainer->update();
+    stats.tock(TrainStats::kForward);
+    {
+      TraceSpan span("backward");
+      cg.backward(l);
+    }
+    stats.tock(TrainStats::kBackward);
+    {
+      TraceSpan span("update");
+      trainer->update();
+      regularizer.update(trainer->learning_rate);
+    }
+    stats.tock(TrainStats::kUpdate);
   }
+  stats.sample_memory();
+  stats.add_sentence(len, n_actions);
   delete parser_state;
   return ret;
 }
@@ -7,13 +7,17 @@
 #include "dynet/training.h"
 #include "parser_builder.h"
 #include "noisify.h"
+#include "trainer_utils.h"
+#include "train_stats.h"
 
 struct SupervisedEnsembleStaticTrainer {
   ParserStateBuilder & state_builder;
   const Noisifier& noisifier;
-  float lambda_;
+  L2Regularizer regularizer;
   float epsilon;
   unsigned n_pretrained;
+  bool drop_forced;
+  TrainStats stats;
 
   SupervisedEnsembleStaticTrainer(const po::variables_map& conf,
                                   const Noisifier& noisifier,
@@ -4,6 +4,8 @@
 #include "tree.h"
 #include <fstream>
 #include <sstream>
+#include <map>
+#include <algorithm>
 
 void get_orders(Corpus& corpus,
                 std::vector<unsigned>& order,
@@ -24,6 +26,104 @@ void get_orders(Corpus& corpus,
   }
 }
 
+void shuffle_orders(Corpus& corpus,
+                    std::vector<unsigned>& order,
+                    unsigned bucket_width,
+                    std::mt19937& engine) {
+  if (bucket_width == 0) {
+    std::shuffle(order.begin(), order.end(), engine);
+    return;
+  }
+  std::map<unsigned, std::vector<unsigned>> buckets;
+  for (unsigned sid : order) {
+    buckets[corpus.training_inputs[sid].size() / bucket_width].push_back(sid);
+  }
+  std::vector<std::vector<unsigned>*> bucket_order;
+  for (auto& payload : buckets) {
+    std::shuffle(payload.second.begin(), payload.second.end(), engine);
+    bucket_order.push_back(&payload.second);
+  }
+  std::shuffle(bucket_order.begin(), bucket_order.end(), engine);
+
+  order.clear();
+  for (const std::vector<unsigned>* bucket : bucket_order) {
+    order.insert(order.end(), bucket->begin(), bucket->end());
+  }
+}
+
+po::options_description L2Regularizer::get_options() {
+  po::options_description cmd("Regularizer options");
+  cmd.add_options()
+    ("lambda", po::value<float>()->default_value(0.), "The L2 regularizer, should not set in --dynet-l2.")
+    ("lambda_mode", po::value<std::string>()->default_value("graph"), "How the L2 regularizer is applied [graph|decay], decay scales the weights after the updates instead of adding the norms to every sentence graph.")
+    ("lambda_decay_every", po::value<unsigned>()->default_value(1), "In the decay mode, defer the weight decay and catch it up every n updates.")
+    ;
+  return cmd;
+}
+
+L2Regularizer::L2Regularizer(const po::variables_map& conf,
+                             dynet::ParameterCollection & model,
+                             const std::string & tag) :
+  model(model),
+  lambda_(conf["lambda"].as<float>()),
+  decay(false),
+  decay_every(1),
+  n_pending(0),
+  weight(0.f),
+  pending_scale(1.) {
+  std::string mode = conf["lambda_mode"].as<std::string>();
+  if (mode == "decay") {
+    decay = true;
+    decay_every = std::max(conf["lambda_decay_every"].as<unsigned>(), 1u);
+  } else if (mode != "graph") {
+    _ERROR << tag << ":: unknown lambda mode: " << mode;
+    exit(1);
+  }
+  _INFO << tag << ":: lambda = " << lambda_;
+  if (decay && lambda_ > 0.f) {
+    _INFO << tag << ":: L2 applied as weight decay every " << decay_every << " updates";
+    if (conf.count("optimizer") && conf["optimizer"].as<std::string>() != "simple_sgd") {
+      _WARN << tag << ":: the weight decay is decoupled from the " << conf["optimizer"].as<std::string>()
+        << " update, it is not equivalent to the L2 loss.";
+    }
+  }
+}
+
+dynet::Expression L2Regularizer::regularize(const dynet::Expression & loss,
+                                            float weight,
+                                            const std::vector<dynet::Expression> & params) {
+  if (lambda_ == 0.f) { return loss; }
+  if (decay) {
+    this->weight += weight;
+    return loss;
+  }
+  std::vector<dynet::Expression> reg;
+  for (auto e : params) { reg.push_back(dynet::squared_norm(e)); }
+  return loss + 0.5 * weight * lambda_ * dynet::sum(reg);
+}
+
+void L2Regularizer::update(float eta) {
+  if (!decay || weight == 0.f) { return; }
+  // the gradient of the L2 loss is weight * lambda * w.
+  double scale = 1. - double(eta) * lambda_ * weight;
+  if (scale < 0.) {
+    _WARN << "L2:: decay " << scale << " out of range, clipped.";
+    scale = 0.;
+  }
+  pending_scale *= scale;
+  weight = 0.f;
+  if (++n_pending >= decay_every) { flush(); }
+}
+
+void L2Regularizer::flush() {
+  n_pending = 0;
+  if (pending_scale == 1.) { return; }
+  for (auto & p : model.parameters_list()) {
+    p->scale_parameters(static_cast<float>(pending_scale));
+  }
+  pending_scale = 1.;
+}
+
 std::string get_model_name(const po::variables_map& conf,
                            const std::string& prefix) {
   std::ostringstream os;
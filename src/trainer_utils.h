@@ -3,9 +3,11 @@
 
 #include <iostream>
 #include <set>
+#include <random>
 #include <boost/program_options.hpp>
 #include "corpus.h"
 #include "dynet/model.h"
+#include "dynet/expr.h"
 #include "dynet/training.h"
 
 namespace po = boost::program_options;
@@ -15,6 +17,15 @@ void get_orders(Corpus& corpus,
                 bool allow_nonprojective,
                 bool allow_partial_tree);
 
+/// Shuffle the training order. With a bucket width of 0, the order is fully
+/// shuffled. Otherwise sentences are grouped into buckets of similar length
+/// (length / bucket_width), shuffled within each bucket, and the order of
+/// the buckets is shuffled, so adjacent sentences have similar graph sizes.
+void shuffle_orders(Corpus& corpus,
+                    std::vector<unsigned>& order,
+                    unsigned bucket_width,
+                    std::mt19937& engine);
+
 po::options_description get_optimizer_options();
 
 dynet::Trainer* get_trainer(const po::variables_map& conf,
@@ -25,6 +36,39 @@ void update_trainer(const po::variables_map& conf,
                     const float & iter,
                     dynet::Trainer* trainer);
 
+/// The L2 regularizer over the non-lookup parameters. In the graph mode,
+/// 0.5 * weight * lambda * |w|^2 is added to the loss of every sentence. In
+/// the decay mode, the weights are instead scaled by (1 - eta * lambda * weight)
+/// after the update, which is the same SGD step up to O(eta^2). The scaling
+/// can be deferred over several updates and caught up as one product.
+struct L2Regularizer {
+  dynet::ParameterCollection & model;
+  float lambda_;
+  bool decay;
+  unsigned decay_every;
+  unsigned n_pending;
+  float weight;
+  double pending_scale;
+
+  static po::options_description get_options();
+
+  L2Regularizer(const po::variables_map& conf,
+                dynet::ParameterCollection & model,
+                const std::string & tag);
+
+  /// Return the loss with the regularizer of the given weight. In the decay
+  /// mode, the loss is returned as is and the weight is kept for the update.
+  dynet::Expression regularize(const dynet::Expression & loss,
+                               float weight,
+                               const std::vector<dynet::Expression> & params);
+
+  /// Record the decay of the update just made with the learning rate eta.
+  void update(float eta);
+
+  /// Apply the pending decay, should be called before the parameters are read.
+  void flush();
+};
+
 std::string get_model_name(const po::variables_map& conf,
                            const std::string& prefix);
 